@@ -104,6 +104,9 @@ public:
   bool write(const char *bytes, size_t n);
   /// Write to stdin. Convenience function using write(const char *, size_t).
   bool write(const std::string &data);
+  /// Write to stdin without blocking. Returns the number of bytes written (0 if the pipe is full) or -1 on errors.
+  /// The stdin pipe is kept non-blocking after the first call.
+  long try_write(const char *bytes, size_t n);
   /// Close stdin. If the process takes parameters from stdin, use this to notify that all parameters have been sent.
   void close_stdin() noexcept;
 
@@ -124,6 +127,7 @@ private:
   std::thread stdout_thread, stderr_thread;
 #endif
   bool open_stdin;
+  bool stdin_nonblocking = false;
   std::mutex stdin_mutex;
 
   Config config;
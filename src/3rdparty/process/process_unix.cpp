@@ -1,5 +1,6 @@
 #include "process.hpp"
 #include <bitset>
+#include <cerrno>
 #include <cstdlib>
 #include <fcntl.h>
 #include <poll.h>
@@ -328,6 +329,27 @@ bool Process::write(const char *bytes, size_t n) {
   return false;
 }
 
+long Process::try_write(const char *bytes, size_t n) {
+  if(!open_stdin)
+    throw std::invalid_argument("Can't write to an unopened stdin pipe. Please set open_stdin=true when constructing the process.");
+
+  std::lock_guard<std::mutex> lock(stdin_mutex);
+  if(!stdin_fd)
+    return -1;
+  if(!stdin_nonblocking) {
+    if(fcntl(*stdin_fd, F_SETFL, fcntl(*stdin_fd, F_GETFL) | O_NONBLOCK) != 0)
+      return -1;
+    stdin_nonblocking = true;
+  }
+  ssize_t written;
+  do {
+    written = ::write(*stdin_fd, bytes, n);
+  } while(written < 0 && errno == EINTR);
+  if(written < 0)
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+  return static_cast<long>(written);
+}
+
 void Process::close_stdin() noexcept {
   std::lock_guard<std::mutex> lock(stdin_mutex);
   if(stdin_fd) {
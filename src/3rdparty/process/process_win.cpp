@@ -259,6 +259,25 @@ bool Process::write(const char *bytes, size_t n) {
   return false;
 }
 
+long Process::try_write(const char *bytes, size_t n) {
+  if(!open_stdin)
+    throw std::invalid_argument("Can't write to an unopened stdin pipe. Please set open_stdin=true when constructing the process.");
+
+  std::lock_guard<std::mutex> lock(stdin_mutex);
+  if(!stdin_fd || *stdin_fd == NULL)
+    return -1;
+  if(!stdin_nonblocking) {
+    DWORD mode = PIPE_READMODE_BYTE | PIPE_NOWAIT;
+    if(!SetNamedPipeHandleState(*stdin_fd, &mode, nullptr, nullptr))
+      return -1;
+    stdin_nonblocking = true;
+  }
+  DWORD written = 0;
+  if(!WriteFile(*stdin_fd, bytes, static_cast<DWORD>(n), &written, nullptr))
+    return -1;
+  return static_cast<long>(written);
+}
+
 void Process::close_stdin() noexcept {
   std::lock_guard<std::mutex> lock(stdin_mutex);
   if(stdin_fd) {
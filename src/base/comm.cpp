@@ -27,6 +27,8 @@
 #include <regex>
 #include <fstream>
 #include <iomanip> // for setfill, setw
+#include <thread>
+#include <atomic>
 
 // for scaning files from a given path
 #ifdef _WIN32
@@ -265,6 +267,36 @@ namespace banksia {
         return vec;
     }
     
+    void parallelFor(int n, const std::function<void(int)>& fn, int threadCnt)
+    {
+        if (threadCnt <= 0) {
+            threadCnt = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        threadCnt = std::min(threadCnt, n);
+        if (threadCnt <= 1) {
+            for(int i = 0; i < n; i++) {
+                fn(i);
+            }
+            return;
+        }
+        
+        std::atomic<int> next(0);
+        auto work = [&]() {
+            for(int i = next++; i < n; i = next++) {
+                fn(i);
+            }
+        };
+        
+        std::vector<std::thread> threadList;
+        for(int i = 1; i < threadCnt; i++) {
+            threadList.push_back(std::thread(work));
+        }
+        work();
+        for(auto && t : threadList) {
+            t.join();
+        }
+    }
+    
     std::string formatPeriod(int seconds)
     {
         int s = seconds % 60, minutes = seconds / 60, m = minutes % 60, hours = minutes / 60, h = hours % 24, d = hours / 24;
@@ -377,6 +409,14 @@ namespace banksia {
         if (0 != err) return 0;
         return fileStat.st_size;
     }
+
+    i64 getFileModifiedTime(const std::string& path)
+    {
+        struct __stat64 fileStat;
+        int err = _stat64(path.c_str(), &fileStat );
+        if (0 != err) return 0;
+        return fileStat.st_mtime;
+    }
     
     bool isExecutable(const std::string& path)
     {
@@ -452,6 +492,15 @@ namespace banksia {
         return st.st_size;
     }
 
+    i64 getFileModifiedTime(const std::string& fileName)
+    {
+        struct stat st;
+        if(stat(fileName.c_str(), &st) != 0) {
+            return 0;
+        }
+        return st.st_mtime;
+    }
+
     bool isExecutable(const std::string& path)
     {
         return !access(path.c_str(), X_OK);
@@ -471,19 +520,19 @@ namespace banksia {
 		GetSystemInfo(&sysinfo);
 		return sysinfo.dwNumberOfProcessors;
 #elif MACOS
-        int nm[2];
-        size_t len = 4;
-        uint32_t count;
-     
-        nm[0] = CTL_HW; nm[1] = HW_AVAILCPU;
-        sysctl(nm, 2, &count, &len, NULL, 0);
-     
-        if(count < 1) {
-            nm[1] = HW_NCPU;
-            sysctl(nm, 2, &count, &len, NULL, 0);
-            if(count < 1) { count = 1; }
-            }
-        return count;
+        int nm[2];
+        size_t len = 4;
+        uint32_t count;
+     
+        nm[0] = CTL_HW; nm[1] = HW_AVAILCPU;
+        sysctl(nm, 2, &count, &len, NULL, 0);
+     
+        if(count < 1) {
+            nm[1] = HW_NCPU;
+            sysctl(nm, 2, &count, &len, NULL, 0);
+            if(count < 1) { count = 1; }
+            }
+        return count;
 #else
         return int(sysconf(_SC_NPROCESSORS_ONLN));
 #endif
@@ -33,6 +33,7 @@
 #include <algorithm>
 #include <mutex>
 #include <ctime>
+#include <functional>
 
 #include <assert.h>
 
@@ -175,6 +176,9 @@ namespace banksia {
     
     std::vector<std::string> readTextFileToArray(const std::string& path);
     
+    // Call fn(0) ... fn(n - 1) from up to threadCnt threads (0: number of cores), return when all calls are done
+    void parallelFor(int n, const std::function<void(int)>& fn, int threadCnt = 0);
+    
     std::string posToCoordinateString(int pos);
     int coordinateStringToPos(const char* str);
     
@@ -189,6 +193,7 @@ namespace banksia {
     std::string getFullPath(const char* path);
     std::vector<std::string> listdir(std::string dirname);
     i64 getFileSize(const std::string& path);
+    i64 getFileModifiedTime(const std::string& path);
     bool isExecutable(const std::string& path);
     bool isRunning(int pid);
     int getNumberOfCores();
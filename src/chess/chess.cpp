@@ -26,6 +26,7 @@
 #include <iomanip> // for setprecision
 #include <fstream>
 #include <iostream>
+#include <unordered_map>
 
 #include "chess.h"
 #include "../3rdparty/fathom/tbprobe.h"
@@ -330,6 +331,41 @@ std::string ChessBoard::getFen(int halfCount, int fullMoveCount) const {
     return stringStream.str();
 }
 
+void ChessBoard::toPacked(PackedPosition& packed) const
+{
+    memset(&packed, 0, sizeof(PackedPosition));
+    for (int i = 0; i < 64; i++) {
+        auto piece = getPiece(i);
+        if (piece.isEmpty()) continue;
+        auto k = static_cast<int>(piece.type) | (piece.side == Side::white ? 8 : 0);
+        packed.pieces[i >> 1] |= k << ((i & 1) * 4);
+    }
+    packed.flags = (side == Side::white ? 1 : 0) | castleRights[W] << 1 | castleRights[B] << 3;
+    packed.enpassant = static_cast<int8_t>(enpassant);
+}
+
+void ChessBoard::fromPacked(const PackedPosition& packed)
+{
+    reset();
+    histList.clear();
+    startFen = "";
+    
+    for (int i = 0; i < 64; i++) {
+        auto k = packed.pieces[i >> 1] >> ((i & 1) * 4) & 0xf;
+        if (k & 7) {
+            setPiece(i, Piece(static_cast<PieceType>(k & 7), k & 8 ? Side::white : Side::black));
+        }
+    }
+    
+    side = packed.flags & 1 ? Side::white : Side::black;
+    castleRights[W] = packed.flags >> 1 & CastleRight_mask;
+    castleRights[B] = packed.flags >> 3 & CastleRight_mask;
+    enpassant = packed.enpassant;
+    status = 0;
+    quietCnt = 0;
+    hashKey = initHashKey();
+}
+
 void ChessBoard::gen_addMove(std::vector<MoveFull>& moveList, int from, int dest, bool captureOnly) const
 {
     auto toSide = getPiece(dest).side;
@@ -1835,30 +1871,50 @@ u64 polyglotRandom64[781] = {
 };
 
 
-extern std::map<u64, std::string> ecoMap;
+extern std::unordered_map<u64, std::string> ecoMap;
+
+// Split entries of ecoMap, kept by their keys since games of a tournament meet the same openings
+// again and again. The commented string is the last item. Items are never erased, thus references stay valid
+static std::unordered_map<u64, std::vector<std::string>> ecoSplitCache;
+static std::mutex ecoSplitCacheMutex;
+
+static const std::vector<std::string>& getSplitEco(u64 key, const std::string& str)
+{
+    std::lock_guard<std::mutex> lock(ecoSplitCacheMutex);
+    auto it = ecoSplitCache.find(key);
+    if (it != ecoSplitCache.end()) {
+        return it->second;
+    }
+    
+    auto vec = splitString(str, ';');
+    if (vec.size() > 1) {
+        auto ecoString = vec.front() + ": " + vec.at(1);
+        if (vec.size() > 2) {
+            ecoString += ", " + vec.at(2);
+        }
+        vec.push_back(ecoString);
+    }
+    return ecoSplitCache[key] = vec;
+}
 
 std::vector<std::string> ChessBoard::commentEcoString()
 {
-    std::vector<std::string> vec;
     for(int i = int(histList.size() - 1); i >= 0; i--) {
         auto& hist = histList[i];
         auto it = ecoMap.find(hist.hashKey);
         if (it != ecoMap.end()) {
-            vec = splitString(it->second, ';');
+            auto& vec = getSplitEco(it->first, it->second);
             if (vec.size() > 1) {
-                auto ecoString = vec.front() + ": " + vec.at(1);
-                if (vec.size() > 2) {
-                    ecoString += ", " + vec.at(2);
-                }
-                hist.comment += ecoString;
+                hist.comment += vec.back();
+                return std::vector<std::string>(vec.begin(), vec.end() - 1);
             }
             return vec;
         }
     }
-    return vec;
+    return std::vector<std::string>();
 }
 
-std::map<u64, std::string> ecoMap
+std::unordered_map<u64, std::string> ecoMap
 {
     {17746977930792137ULL, "D08;QGD;Albin counter-gambit"},{18828346148881476ULL, "D20;QGA;Linares variation"},{22186996187002557ULL, "D57;QGD;Lasker defence, Bernstein variation"},{34585945880640199ULL, "C55;two knights;Max Lange attack, Loman defence"},
     {50097418745942009ULL, "B35;Sicilian;accelerated fianchetto, modern variation with Bc4"},{75353901211836495ULL, "D44;QGD semi-Slav;5.Bg5 dc"},{81088336057533745ULL, "B72;Sicilian;dragon, classical, Amsterdam variation"},{92768586179066125ULL, "B15;Caro-Kann;Forgacs variation"},
@@ -33,6 +33,15 @@ namespace banksia {
     
     extern const char* originalFen;
     
+    // A position in 34 bytes: 4 bits per square (piece type, bit 3 for white),
+    // side to move and castle rights in flags, enpassant (-1 if none)
+    class PackedPosition {
+    public:
+        u8 pieces[32];
+        u8 flags;
+        int8_t enpassant;
+    };
+    
     class ChessBoard : public BoardCore {
         
         const int CastleRight_long  = (1<<0);
@@ -59,6 +68,9 @@ namespace banksia {
         virtual void setFen(const std::string& fen) override;
         virtual std::string getFen(int halfCount = 0, int fullMoveCount = 1) const override;
         
+        void toPacked(PackedPosition& packed) const;
+        void fromPacked(const PackedPosition& packed);
+        
         bool isLegalMove(int from, int dest, PieceType promotion = PieceType::empty);
         
         virtual void gen(std::vector<MoveFull>& moveList, Side attackerSide) const;
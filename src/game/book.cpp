@@ -25,63 +25,170 @@
 
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <thread>
 
 #include "book.h"
 
 using namespace banksia;
 
-void BookEdp::load(const std::string& _path, int _maxPly, int _top100)
+// Positions of an epd file are validated and packed once then saved next to
+// the file (path + ".cache"), the cache is used while the epd file is unchanged
+struct BookEdpCacheHeader {
+    char signature[8];
+    i64 fileSize, fileModifiedTime;
+    u64 count;
+};
+
+static const char* bookEdpCacheSignature = "BKSEPD1";
+
+bool BookEdp::loadCache(const std::string& cachePath)
 {
-    path = _path; maxPly = _maxPly; top100 = _top100;
-    stringVec = readTextFileToArray(path);
+    std::ifstream ifs(cachePath, std::ios::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+    
+    BookEdpCacheHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.signature, bookEdpCacheSignature, 8) != 0
+        || header.fileSize != getFileSize(path)
+        || header.fileModifiedTime != getFileModifiedTime(path)
+        || static_cast<i64>(header.count * sizeof(PackedPosition) + sizeof(header)) != getFileSize(cachePath)) {
+        return false;
+    }
+    
+    positions.resize(header.count);
+    if (!ifs.read(reinterpret_cast<char*>(positions.data()), header.count * sizeof(PackedPosition))) {
+        positions.clear();
+        return false;
+    }
+    return true;
 }
 
-std::string BookEdp::getRandomFEN() const
+// The cache is written into a temporary file then renamed. Books of the same epd file
+// may be loaded at the same time, they never write into one file and readers never see
+// a half-written cache
+void BookEdp::saveCache(const std::string& cachePath) const
 {
-    if (!stringVec.empty()) {
-        for(int atemp = 0; atemp < 5; atemp++) {
-            size_t k = size_t(std::rand()) % stringVec.size();
-            auto str = stringVec.at(k);
-            if (!str.empty()) {
-                ChessBoard board;
+    std::ostringstream stringStream;
+    stringStream << cachePath << "." << std::this_thread::get_id() << ".tmp";
+    auto tmpPath = stringStream.str();
+    
+    std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        return; // the cache is optional, e.g. the folder is read-only
+    }
+    
+    BookEdpCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.signature, bookEdpCacheSignature, 8);
+    header.fileSize = getFileSize(path);
+    header.fileModifiedTime = getFileModifiedTime(path);
+    header.count = positions.size();
+    
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(PackedPosition));
+    ofs.close();
+    
+    if (!ofs) {
+        std::remove(tmpPath.c_str());
+        return;
+    }
+    
+#ifdef _WIN32
+    std::remove(cachePath.c_str()); // rename doesn't replace existing files
+#endif
+    if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+    }
+}
+
+void BookEdp::load(const std::string& _path, int _maxPly, int _top100)
+{
+    path = _path; maxPly = _maxPly; top100 = _top100;
+    positions.clear();
+    
+    auto cachePath = path + ".cache";
+    if (loadCache(cachePath)) {
+        return;
+    }
+    
+    auto stringVec = readTextFileToArray(path);
+    
+    // validate and pack all positions in parallel, by blocks of lines
+    const int blockSize = 4096;
+    auto blockCnt = static_cast<int>((stringVec.size() + blockSize - 1) / blockSize);
+    std::vector<char> validVec(stringVec.size(), 0);
+    positions.resize(stringVec.size());
+    parallelFor(blockCnt, [&](int b) {
+        ChessBoard board;
+        auto e = std::min(stringVec.size(), size_t(b + 1) * blockSize);
+        for(auto i = size_t(b) * blockSize; i < e; i++) {
+            auto& str = stringVec.at(i);
+            if (!trim(str).empty()) {
                 board.setFen(str);
                 if (board.isValid()) {
-                    return board.getFen();
-                } else {
-                    std::cerr << "Warning: epd position is invalid: " << str << std::endl;
+                    board.toPacked(positions.at(i));
+                    validVec.at(i) = 1;
                 }
             }
         }
+    }, threadCnt);
+    
+    size_t k = 0, invalidCnt = 0;
+    for(size_t i = 0; i < stringVec.size(); i++) {
+        if (validVec.at(i)) {
+            positions.at(k++) = positions.at(i);
+        } else if (!stringVec.at(i).empty()) {
+            invalidCnt++;
+        }
+    }
+    positions.resize(k);
+    positions.shrink_to_fit();
+    
+    if (invalidCnt) {
+        std::cerr << "Warning: removed " << invalidCnt << " invalid epd positions of " << path << std::endl;
     }
     
-    return "";
+    if (!positions.empty()) {
+        saveCache(cachePath);
+    }
 }
 
 bool BookEdp::isEmpty() const
 {
-    return stringVec.empty();
+    return positions.empty();
 }
 
 size_t BookEdp::size() const
 {
-    return stringVec.size();
+    return positions.size();
 }
 
 bool BookEdp::getRandomBook(std::string& fenString, std::vector<Move>&) const
 {
-    fenString = getRandomFEN();
-    return !fenString.empty();
+    if (positions.empty()) {
+        return false;
+    }
+    size_t k = size_t(std::rand()) % positions.size();
+    ChessBoard board;
+    board.fromPacked(positions.at(k));
+    fenString = board.getFen();
+    return true;
 }
 
 /////////////////////////////////
 bool BookPgn::isEmpty() const
 {
-    return moves.empty();
+    return lineStarts.empty();
 }
 
 size_t BookPgn::size() const
 {
-    return moves.size();
+    return lineStarts.size();
 }
 
 std::vector<Move> BookPgn::moveString2Moves(const std::string& str)
@@ -100,48 +207,206 @@ std::vector<Move> BookPgn::moveString2Moves(const std::string& str)
     return list;
 }
 
-bool BookPgn::addPgnMoves(const std::string& str)
+// from: 6 bits, dest: 6 bits, promotion: 3 bits
+u16 BookPgn::packMove(const Move& move)
 {
-    if (!str.empty()) {
-        auto list = moveString2Moves(str);
-        if (!list.empty()) {
-            moves.push_back(list);
-            return true;
-        }
+    return static_cast<u16>(move.from | move.dest << 6 | static_cast<int>(move.promotion) << 12);
+}
+
+Move BookPgn::unpackMove(u16 packedMove)
+{
+    return Move(packedMove & 0x3f, packedMove >> 6 & 0x3f, static_cast<PieceType>(packedMove >> 12 & 0x7));
+}
+
+bool BookPgn::addLine(const ChessBoard& board, std::unordered_set<u64>& keySet)
+{
+    // openings leading to the same position are duplicates
+    if (board.histList.empty() || !keySet.insert(board.key()).second) {
+        return false;
     }
-    return false;
+    
+    lineStarts.push_back(static_cast<u32>(moveArena.size()));
+    lineKeys.push_back(board.key());
+    for(auto && hist : board.histList) {
+        moveArena.push_back(packMove(hist.move));
+    }
+    return true;
 }
 
 void BookPgn::load(const std::string& _path, int _maxPly, int _top100)
 {
     path = _path; maxPly = _maxPly; top100 = _top100;
     
-    moves.clear();
-    auto vec = readTextFileToArray(path);
-    
-    std::string moveText;
-    for(auto && s : vec) {
-        if (s.find("[") != std::string::npos) {
-            if (s.find("[Event") != std::string::npos) {
-                addPgnMoves(moveText);
-                moveText = "";
+    moveArena.clear();
+    lineStarts.clear();
+    lineKeys.clear();
+    
+    auto fileSize = getFileSize(path);
+    if (fileSize <= 0) {
+        std::cerr << "Error: cannot load book " << path << std::endl;
+        return;
+    }
+    
+    // big files are split into chunks at game boundaries, parsed in parallel
+    // then merged in order thus the result is the same as parsing them sequently
+    const i64 chunkSize = 8 * 1024 * 1024;
+    auto chunkCnt = static_cast<int>((fileSize + chunkSize - 1) / chunkSize);
+    if (chunkCnt <= 1) {
+        loadRange(0, fileSize);
+    } else {
+        std::vector<BookPgn> chunks(static_cast<size_t>(chunkCnt));
+        parallelFor(chunkCnt, [&](int i) {
+            auto& chunk = chunks.at(static_cast<size_t>(i));
+            chunk.path = path; chunk.maxPly = maxPly;
+            chunk.loadRange(chunkSize * i, std::min(fileSize, chunkSize * (i + 1)));
+        }, threadCnt);
+        
+        std::unordered_set<u64> keySet;
+        for(auto && chunk : chunks) {
+            merge(chunk, keySet);
+        }
+    }
+    
+    lineKeys.clear();
+    lineKeys.shrink_to_fit();
+    moveArena.shrink_to_fit();
+    lineStarts.shrink_to_fit();
+}
+
+void BookPgn::merge(const BookPgn& chunk, std::unordered_set<u64>& keySet)
+{
+    for(size_t i = 0; i < chunk.lineStarts.size(); i++) {
+        if (!keySet.insert(chunk.lineKeys.at(i)).second) {
+            continue;
+        }
+        auto b = chunk.moveArena.begin() + chunk.lineStarts.at(i);
+        auto e = i + 1 < chunk.lineStarts.size() ? chunk.moveArena.begin() + chunk.lineStarts.at(i + 1) : chunk.moveArena.end();
+        lineStarts.push_back(static_cast<u32>(moveArena.size()));
+        lineKeys.push_back(chunk.lineKeys.at(i));
+        moveArena.insert(moveArena.end(), b, e);
+    }
+}
+
+// Parse games which start (their [Event tag) from begin to end of the file.
+// The file is read line by line and each game is replayed only up to maxPly,
+// the rest of its move text is skipped without parsing
+void BookPgn::loadRange(i64 begin, i64 end)
+{
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Error: cannot load book " << path << std::endl;
+        return;
+    }
+    
+    std::unordered_set<u64> keySet;
+    ChessBoard board;
+    board.newGame();
+    
+    // skipping: the game reached maxPly or has an illegal move (broken)
+    auto skipping = false, broken = false, inComment = false;
+    auto variationDepth = 0;
+    std::string line, token;
+    
+    // the chunk starts in the middle of a game of the previous chunk
+    auto seeking = begin > 0;
+    i64 pos = 0;
+    if (seeking) {
+        inFile.seekg(begin - 1);
+        std::getline(inFile, line);
+        pos = begin + static_cast<i64>(line.size());
+    }
+    
+    auto newGame = [&]() {
+        if (!broken) {
+            addLine(board, keySet);
+        }
+        board.histList.clear(); // setFen doesn't clear the history
+        board.newGame();
+        skipping = broken = inComment = false;
+        variationDepth = 0;
+    };
+    
+    auto addToken = [&]() {
+        if (token.length() >= 2 && !isdigit(token.at(0)) && token.at(0) != '$') {
+            auto move = board.fromSanString(token);
+            if (!board.checkMake(move.from, move.dest, move.promotion)) {
+                broken = skipping = true;
+            } else if (maxPly > 0 && static_cast<int>(board.histList.size()) >= maxPly) {
+                skipping = true;
+            }
+        }
+        token.clear();
+    };
+    
+    while (pos < end || !seeking) {
+        auto lineStart = pos;
+        if (!std::getline(inFile, line)) {
+            break;
+        }
+        pos += static_cast<i64>(line.size()) + 1;
+        
+        if (!inComment) {
+            auto p = line.find_first_not_of(" \t");
+            if (p != std::string::npos && line.at(p) == '[') {
+                if (line.compare(p, 6, "[Event") == 0) {
+                    if (lineStart >= end) {
+                        break; // that game belongs to the next chunk
+                    }
+                    seeking = false;
+                    newGame();
+                }
                 continue;
             }
+        }
+        
+        if (skipping || seeking) {
             continue;
         }
-        moveText += " " + s;
+        
+        for(auto ch : line) {
+            if (inComment) {
+                inComment = ch != '}';
+                continue;
+            }
+            if (ch == '{' || ch == ';' || ch == '(' || ch == ')'
+                || ch == '.' || isspace(ch)) {
+                if (!token.empty() && variationDepth == 0) {
+                    addToken();
+                    if (skipping) break;
+                }
+                token.clear();
+                
+                if (ch == ';') break;
+                if (ch == '{') inComment = true;
+                else if (ch == '(') variationDepth++;
+                else if (ch == ')') variationDepth = std::max(0, variationDepth - 1);
+                continue;
+            }
+            token += ch;
+        }
+        
+        if (!token.empty() && variationDepth == 0 && !skipping) {
+            addToken();
+        }
+        token.clear();
     }
-    addPgnMoves(moveText);
+    newGame();
 }
 
 
 bool BookPgn::getRandomBook(std::string&, std::vector<Move>& moveList) const
 {
-    if (moves.empty()) {
+    moveList.clear();
+    if (lineStarts.empty()) {
         return false;
     }
-    size_t k = size_t(std::rand()) % moves.size();
-    moveList = moves.at(k);
+    size_t k = size_t(std::rand()) % lineStarts.size();
+    size_t begin = lineStarts.at(k), end = k + 1 < lineStarts.size() ? lineStarts.at(k + 1) : moveArena.size();
+    
+    moveList.reserve(end - begin);
+    for(auto i = begin; i < end; i++) {
+        moveList.push_back(unpackMove(moveArena.at(i)));
+    }
     return !moveList.empty();
 }
 
@@ -224,9 +489,13 @@ void BookPolyglot::load(const std::string& _path, int _maxPly, int _top100)
     ifs.seekg(0, std::ios::beg);
     ifs.read((char*)items, length);
     
-    for(i64 i = 0; i < itemCnt; i++) {
-        items[i].convertToLittleEndian();
-    }
+    const i64 blockSize = 1024 * 1024;
+    parallelFor(static_cast<int>((itemCnt + blockSize - 1) / blockSize), [&](int b) {
+        auto e = std::min(itemCnt, blockSize * (b + 1));
+        for(i64 i = blockSize * b; i < e; i++) {
+            items[i].convertToLittleEndian();
+        }
+    }, threadCnt);
 }
 
 bool BookPolyglot::isValid() const
@@ -434,9 +703,11 @@ bool BookMng::load(const Json::Value& obj)
     s = "books";
     if (obj.isMember(s) && obj[s].isArray()) {
         auto array = obj[s];
+        std::vector<BookLoadTask> taskList;
         for (Json::Value::const_iterator it = array.begin(); it != array.end(); ++it) {
-            r = loadSingle(*it) || r;
+            r = loadSingle(*it, taskList) || r;
         }
+        loadBooks(taskList);
     }
     
 //    std::cout << "opening books loaded, total items: " << size()
@@ -445,7 +716,7 @@ bool BookMng::load(const Json::Value& obj)
     return r;
 }
 
-bool BookMng::loadSingle(const Json::Value& obj)
+bool BookMng::loadSingle(const Json::Value& obj, std::vector<BookLoadTask>& taskList)
 {
     if (!obj.isMember("type") || !obj.isMember("path")
         ) {
@@ -484,19 +755,54 @@ bool BookMng::loadSingle(const Json::Value& obj)
             default:
                 return false;
         }
-        book->load(path, maxPly, top100);
-        if (book->isEmpty()) {
-            delete book;
-        } else {
-            bookList.push_back(book);
-        }
-        
+        taskList.push_back(BookLoadTask { book, path, maxPly, top100 });
         return true;
     }
     
     return false;
 }
 
+// Books are loaded concurrently, they are added into bookList by their order in the JSON file
+void BookMng::loadBooks(std::vector<BookLoadTask>& taskList)
+{
+    if (taskList.empty()) {
+        return;
+    }
+    
+    std::mutex printMutex;
+    auto doneCnt = 0;
+    auto total = static_cast<int>(taskList.size());
+    
+    // one thread budget: books * threads of each book <= cores
+    auto cores = std::max(1, getNumberOfCores());
+    auto bookThreadCnt = std::min(total, cores);
+    for(auto && task : taskList) {
+        task.book->threadCnt = std::max(1, cores / bookThreadCnt);
+    }
+    
+    parallelFor(total, [&](int i) {
+        auto& task = taskList.at(static_cast<size_t>(i));
+        auto startTime = std::chrono::steady_clock::now();
+        task.book->load(task.path, task.maxPly, task.top100);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        
+        std::lock_guard<std::mutex> dolock(printMutex);
+        doneCnt++;
+        if (total > 1 || elapsed >= 1000) {
+            std::cout << "Loaded opening book " << doneCnt << "/" << total << ": " << task.path
+            << ", items: " << task.book->size() << ", " << elapsed << " ms" << std::endl;
+        }
+    }, bookThreadCnt);
+    
+    for(auto && task : taskList) {
+        if (task.book->isEmpty()) {
+            delete task.book;
+        } else {
+            bookList.push_back(task.book);
+        }
+    }
+}
+
 Json::Value BookMng::saveToJson() const
 {
     Json::Value obj;
@@ -532,10 +838,7 @@ bool BookMng::getRandomBook(int pairId, std::string& fenString, std::vector<Move
         bookSelectType == BookSelectType::allnew ||
         (bookSelectType == BookSelectType::samepair && pairId != lastPairIdx)
         ) {
-        theFenString = "";
-        theMoves.clear();
-        auto k = size_t(rand()) % bookList.size();
-        bookList.at(k)->getRandomBook(theFenString, theMoves);
+        getNewRandomBook(theFenString, theMoves);
     }
     
     lastPairIdx = pairId;
@@ -545,3 +848,43 @@ bool BookMng::getRandomBook(int pairId, std::string& fenString, std::vector<Move
     return true;
 }
 
+u64 BookMng::getOpeningKey(const std::string& fenString, const std::vector<Move>& moves)
+{
+    ChessBoard board;
+    board.newGame(fenString);
+    for(auto && move : moves) {
+        if (!board.checkMake(move.from, move.dest, move.promotion)) {
+            break;
+        }
+    }
+    return board.key();
+}
+
+void BookMng::dropOpening(u64 key)
+{
+    droppedKeySet.insert(key);
+}
+
+bool BookMng::isDropped(u64 key) const
+{
+    return droppedKeySet.find(key) != droppedKeySet.end();
+}
+
+bool BookMng::getNewRandomBook(std::string& fenString, std::vector<Move>& moves)
+{
+    if (bookList.empty()) {
+        return false;
+    }
+    
+    // give up avoiding dropped openings after some attempts, books may have few openings only
+    for(int atemp = 0; atemp < 20; atemp++) {
+        fenString = "";
+        moves.clear();
+        auto k = size_t(rand()) % bookList.size();
+        if (bookList.at(k)->getRandomBook(fenString, moves)
+            && (droppedKeySet.empty() || !isDropped(getOpeningKey(fenString, moves)))) {
+            return true;
+        }
+    }
+    return false;
+}
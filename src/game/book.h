@@ -27,6 +27,7 @@
 #define book_h
 
 #include <stdio.h>
+#include <unordered_set>
 
 #include "../chess/chess.h"
 
@@ -56,6 +57,10 @@ namespace banksia {
         virtual void load(const std::string& path, int maxPly, int top100) = 0;
         BookType type;
         
+        // threads for loading a big file by parts (0: number of cores), books loaded
+        // at the same time share the cores
+        int threadCnt = 0;
+        
     protected:
         std::string path;
         int maxPly = PologlotDefaultMaxPly, top100 = 0;
@@ -75,8 +80,10 @@ namespace banksia {
         void load(const std::string& path, int maxPly, int top100) override;
         
     private:
-        std::string getRandomFEN() const;
-        std::vector<std::string> stringVec;
+        bool loadCache(const std::string& cachePath);
+        void saveCache(const std::string& cachePath) const;
+        
+        std::vector<PackedPosition> positions;
     };
 
     class BookPgn : public Book
@@ -92,11 +99,20 @@ namespace banksia {
         bool getRandomBook(std::string& fenString, std::vector<Move>& moves) const override;
         void load(const std::string& path, int maxPly, int top100) override;
         static std::vector<Move> moveString2Moves(const std::string& str);
+
+        static u16 packMove(const Move& move);
+        static Move unpackMove(u16 packedMove);
+
     private:
-        void loadPgnBook(const std::string& path);
-        bool addPgnMoves(const std::string& s);
-        
-        std::vector<std::vector<Move>> moves;
+        void loadRange(i64 begin, i64 end);
+        void merge(const BookPgn& chunk, std::unordered_set<u64>& keySet);
+        bool addLine(const ChessBoard& board, std::unordered_set<u64>& keySet);
+        
+        // all openings are kept as packed moves in one arena, opening i is
+        // from lineStarts[i] to lineStarts[i + 1] (or the end of the arena)
+        std::vector<u16> moveArena;
+        std::vector<u32> lineStarts;
+        std::vector<u64> lineKeys; // final position of each opening, used when loading only
     };
     
     class BookPolyglotItem {
@@ -150,6 +166,13 @@ namespace banksia {
         virtual bool load(const Json::Value& obj) override;
         virtual Json::Value saveToJson() const override;
         bool getRandomBook(int pairId, std::string& fenString, std::vector<Move>& moves);
+        
+        // openings are identified by hash keys of their last positions
+        static u64 getOpeningKey(const std::string& fenString, const std::vector<Move>& moves);
+        void dropOpening(u64 key);
+        bool isDropped(u64 key) const;
+        // a new opening (not a dropped one) regardless of the selection type
+        bool getNewRandomBook(std::string& fenString, std::vector<Move>& moves);
 
         static BookType string2BookType(const std::string& name);
         static std::string bookType2String(BookType type);
@@ -163,11 +186,19 @@ namespace banksia {
         BookSelectType getBookSelectType() const { return bookSelectType; }
 
     private:
-        bool loadSingle(const Json::Value& obj);
+        struct BookLoadTask {
+            Book* book;
+            std::string path;
+            int maxPly, top100;
+        };
+        
+        bool loadSingle(const Json::Value& obj, std::vector<BookLoadTask>& taskList);
+        void loadBooks(std::vector<BookLoadTask>& taskList);
 
         BookSelectType bookSelectType = BookSelectType::allnew;
         
         std::vector<Book*> bookList;
+        std::unordered_set<u64> droppedKeySet;
         
         int queryCnt = 0, lastPairIdx = 1;
         std::string theFenString;
@@ -0,0 +1,119 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <chrono>
+
+#include "completionqueue.h"
+
+using namespace banksia;
+
+CompletionQueue::~CompletionQueue()
+{
+    stop();
+}
+
+void CompletionQueue::start()
+{
+    if (consumer.joinable()) {
+        return;
+    }
+    stopping = false;
+    consumer = std::thread(&CompletionQueue::consumerLoop, this);
+}
+
+void CompletionQueue::stop()
+{
+    stopping = true;
+    waitCv.notify_all();
+    
+    if (consumer.joinable()) {
+        if (consumer.get_id() == std::this_thread::get_id()) {
+            consumer.detach();
+            return;
+        }
+        consumer.join();
+    }
+    
+    // not started or pushed after stopping
+    runTasks();
+}
+
+void CompletionQueue::push(std::function<void()> task)
+{
+    auto node = new Node;
+    node->task = std::move(task);
+    pendingCnt++;
+    
+    auto old = head.load(std::memory_order_relaxed);
+    do {
+        node->next = old;
+    } while (!head.compare_exchange_weak(old, node, std::memory_order_release, std::memory_order_relaxed));
+    
+    waitCv.notify_one();
+}
+
+// Takes all nodes at once, they are in reverse order of pushing
+bool CompletionQueue::runTasks()
+{
+    std::lock_guard<std::mutex> dolock(runMutex);
+    auto node = head.exchange(nullptr, std::memory_order_acquire);
+    if (!node) {
+        return false;
+    }
+    
+    Node* list = nullptr;
+    while (node) {
+        auto next = node->next;
+        node->next = list;
+        list = node;
+        node = next;
+    }
+    
+    while (list) {
+        auto next = list->next;
+        list->task();
+        delete list;
+        pendingCnt--;
+        list = next;
+    }
+    return true;
+}
+
+void CompletionQueue::consumerLoop()
+{
+    while (true) {
+        if (runTasks()) {
+            continue;
+        }
+        if (stopping) {
+            return;
+        }
+        
+        // pushing doesn't lock, the timeout covers a missed notification
+        std::unique_lock<std::mutex> dolock(waitMutex);
+        waitCv.wait_for(dolock, std::chrono::milliseconds(50), [this] {
+            return stopping || head.load() != nullptr;
+        });
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef completionqueue_h
+#define completionqueue_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace banksia {
+    
+    // Tasks pushed from many threads (without locks) and run in order by one consumer thread
+    class CompletionQueue
+    {
+    public:
+        CompletionQueue() {}
+        ~CompletionQueue();
+        
+        void start();
+        // tasks left in the queue are run before returning
+        void stop();
+        
+        void push(std::function<void()> task);
+        
+        // tasks pushed but not completed yet
+        int pending() const {
+            return pendingCnt;
+        }
+        
+    private:
+        class Node {
+        public:
+            std::function<void()> task;
+            Node* next = nullptr;
+        };
+        
+        void consumerLoop();
+        bool runTasks();
+        
+    private:
+        std::atomic<Node*> head { nullptr };
+        std::atomic<int> pendingCnt { 0 };
+        std::atomic<bool> stopping { false };
+        
+        std::thread consumer;
+        std::mutex waitMutex, runMutex;
+        std::condition_variable waitCv;
+    };
+    
+} // namespace banksia
+
+#endif /* completionqueue_h */
@@ -24,6 +24,8 @@
 
 
 #include "configmng.h"
+#include "handshakecache.h"
+#include "jsonreader.h"
 
 namespace banksia {
     
@@ -443,6 +445,8 @@ bool Config::load(const Json::Value& obj)
     
     if (app.isMember("ponderable")) ponderable = app["ponderable"].asBool(); // useful for Winboard only
     if (app.isMember("elo")) elo = app["elo"].asInt();
+    positionFenPly = app.isMember("position fen from ply") ? std::max(0, app["position fen from ply"].asInt()) : 0;
+    writeQueueLimit = app.isMember("write queue limit") ? std::max(0, app["write queue limit"].asInt()) : 0;
     
     variantSet.clear();
     if (app.isMember("variants")) {
@@ -506,6 +510,12 @@ Json::Value Config::saveToJson() const
     if (protocol == Protocol::wb) { // useful for Winboard only
         app["ponderable"] = ponderable;
     }
+    if (positionFenPly > 0) { // useful for UCI only
+        app["position fen from ply"] = positionFenPly;
+    }
+    if (writeQueueLimit > 0) {
+        app["write queue limit"] = writeQueueLimit;
+    }
 
     if (!variantSet.empty()) {
         Json::Value array;
@@ -682,7 +692,7 @@ ConfigMng::~ConfigMng()
 bool ConfigMng::isValid() const
 {
     for(auto && p : configMap) {
-        if (p.first.empty() || !p.second.isValid() || p.first != p.second.name) {
+        if (p.first.empty() || !p.second->isValid() || p.first != p.second->name) {
             return false;
         }
     }
@@ -693,7 +703,7 @@ std::string ConfigMng::toString() const
 {
     std::ostringstream stringStream;
     for(auto && p : configMap) {
-        stringStream << p.second.toString() << std::endl;
+        stringStream << p.second->toString() << std::endl;
     }
     stringStream << std::endl;
     return stringStream.str();
@@ -728,23 +738,68 @@ void ConfigMng::clear()
     configMap.clear();
 }
 
-std::vector<Config> ConfigMng::configList() const
+std::vector<ConfigPtr> ConfigMng::configList() const
 {
-    std::vector<Config> list;
+    std::vector<ConfigPtr> list;
     for(auto && c : configMap) {
         list.push_back(c.second);
     }
     return list;
 }
 
-bool ConfigMng::parseJsonAfterLoading(Json::Value& jsonData)
+// Configs are read by a streaming reader, one at a time, the file could have many engines
+// with long option lists. The root is an array of configs (or an object of them)
+bool ConfigMng::loadFromJsonFile(const std::string& path, bool verbose)
 {
-    for (Json::Value::const_iterator it = jsonData.begin(); it != jsonData.end(); ++it) {
+    setJsonPath(path);
+    
+    JsonReader reader;
+    if (!reader.open(path)) {
+        if (verbose) {
+            std::cerr << "Error: cannot load json file " << path << std::endl;
+        }
+        return false;
+    }
+    
+    // all or nothing: configs read before an error are taken back
+    auto oldConfigMap = configMap;
+    auto exceptionError = false;
+    
+    auto loadConfig = [&]() {
+        Json::Value obj;
+        if (!reader.readValue(obj)) {
+            return false;
+        }
+        
         Config config;
-        config.load(*it);
+        try {
+            config.load(obj);
+        } catch (Json::Exception const& e) {
+            if (verbose) {
+                std::cerr << "Error: Exception when parsing json file - " << e.what() << std::endl;
+            }
+            exceptionError = true;
+            return false;
+        }
         if (editingMode || config.isValid()) {
             insert(config);
         }
+        return true;
+    };
+    
+    if (reader.peek() == JsonReader::ValueType::object) {
+        reader.beginObject();
+        for(std::string key; reader.nextMember(key) && loadConfig();) {}
+    } else if (reader.beginArray()) {
+        while (reader.nextElement() && loadConfig()) {}
+    }
+    
+    if (exceptionError || reader.hasError()) {
+        if (verbose && !exceptionError) {
+            std::cerr << "Error: cannot load (or broken) json file " << path << ", error: " << reader.getError() << std::endl;
+        }
+        configMap = oldConfigMap;
+        return false;
     }
     return true;
 }
@@ -754,28 +809,28 @@ Json::Value ConfigMng::createJsonForSaving()
 {
     Json::Value jsonData;
     for(auto && s : configMap) {
-        auto obj = s.second.saveToJson();
+        auto obj = s.second->saveToJson();
         jsonData.append(obj);
     }
     
     return jsonData;
 }
 
-Config ConfigMng::get(const std::string& name) const
+ConfigPtr ConfigMng::get(const std::string& name) const
 {
     auto it = configMap.find(name);
     if (it != configMap.end()) return it->second;
-    return Config();
+    return nullptr;
 }
 
-Config ConfigMng::get(int idx) const
+ConfigPtr ConfigMng::get(int idx) const
 {
     if (idx < configMap.size()) {
         auto it = configMap.begin();
         std::advance(it, idx);
         return it->second;
     }
-    return Config();
+    return nullptr;
 }
 
 bool ConfigMng::update(const std::string& oldname, const Config& config)
@@ -800,7 +855,7 @@ bool ConfigMng::insert(const Config& config)
         if (configMap.find(config.name) != configMap.end()) {
             std::cerr << "Warning: configuration name's " << config.name << " is repeated. Override data.\n";
         }
-        configMap[config.name] = config;
+        configMap[config.name] = std::make_shared<const Config>(config);
         return true;
     }
     return false;
@@ -862,7 +917,7 @@ void ConfigMng::setSyzygyPath(const std::string& path)
 	assert(syzygyOption.isValid());
 }
 
-Option ConfigMng::checkOverrideOption(const Option& option)
+Option ConfigMng::checkOverrideOption(const Option& option) const
 {
     if (overrideOptionMode && option.isOverridable()) {
 		auto o = getOverrideOption(option.name);
@@ -877,7 +932,7 @@ Option ConfigMng::checkOverrideOption(const Option& option)
     return option;
 }
 
-Option ConfigMng::getOverrideOption(const std::string& name)
+Option ConfigMng::getOverrideOption(const std::string& name) const
 {
 	Option option;
 
@@ -897,3 +952,44 @@ Option ConfigMng::getOverrideOption(const std::string& name)
 	}
 	return option;
 }
+
+// UCI setoption commands of non-default options: ones of the config updated by ones the engine declared
+std::vector<std::string> ConfigMng::createOptionCommands(const Config& config, const std::vector<Option>& engineOptionList) const
+{
+    auto c = config;
+    for(auto && option : engineOptionList) {
+        c.updateOption(option);
+    }
+    
+    std::vector<std::string> cmds;
+    for(auto && option : c.optionList) {
+        auto o = checkOverrideOption(option);
+        if (o.isDefaultValue()) {
+            continue;
+        }
+        
+        cmds.push_back("setoption name " + o.name + " value " + o.getValueAsString());
+    }
+    return cmds;
+}
+
+// Called after loading configs, override options and handshakes: UCI configs with cached handshakes
+// are replaced by snapshots having their option commands, engines will send them without merging
+void ConfigMng::prepareOptionCommands()
+{
+    for(auto && p : configMap) {
+        auto& config = p.second;
+        Handshake handshake;
+        if (config->protocol != Protocol::uci
+            || !handshakeCache.find(config->command, handshake) || handshake.protocol != config->protocol) {
+            continue;
+        }
+        
+        auto snapshot = std::make_shared<Config>(*config);
+        snapshot->optionCommandList = createOptionCommands(*config, handshake.optionList);
+        snapshot->optionHandshakeModified = handshake.modified;
+        snapshot->optionHandshakeSize = handshake.size;
+        snapshot->optionCommandsPrepared = true;
+        config = snapshot;
+    }
+}
@@ -27,6 +27,7 @@
 
 #include <vector>
 #include <set>
+#include <memory>
 
 #include "player.h"
 
@@ -139,8 +140,19 @@ namespace banksia {
         std::vector<Option> optionList;
         
         bool ponderable = true; // for Winboard protocol only
+        int positionFenPly = 0; // for UCI only, send 'position fen' of current board from that ply, 0 is off
+        int writeQueueLimit = 0; // KB of commands the engine hasn't read yet before it is stalled, 0 is default
+        
+        // UCI only, prepared by ConfigMng::prepareOptionCommands: commands of the options merged with
+        // the cached handshake (of the given binary modified time and size), overridden values applied
+        bool optionCommandsPrepared = false;
+        i64 optionHandshakeModified = 0, optionHandshakeSize = 0;
+        std::vector<std::string> optionCommandList;
     };
     
+    // Configs are immutable snapshots once stored in ConfigMng, shared by all engines using them
+    typedef std::shared_ptr<const Config> ConfigPtr;
+    
     class ConfigMng : public Obj, public JsonSavable
     {
     public:
@@ -154,8 +166,9 @@ namespace banksia {
         bool isValid() const override;
         std::string toString() const override;
         
-        Config get(const std::string& name) const;
-        Config get(int idx) const;
+        // nullptr if not found
+        ConfigPtr get(const std::string& name) const;
+        ConfigPtr get(int idx) const;
         
         bool update(const std::string& oldname, const Config&);
         bool update(const Config&);
@@ -168,7 +181,7 @@ namespace banksia {
 
         size_t size() const;
         void clear();
-        std::vector<Config> configList() const;
+        std::vector<ConfigPtr> configList() const;
         
         void setEditingMode(bool mode) {
             editingMode = mode;
@@ -176,12 +189,18 @@ namespace banksia {
 
         int getElo(const std::string& name) const {
             auto config = get(name);
-            return config.isValid() ? config.elo : 0;
+            return config && config->isValid() ? config->elo : 0;
         }
 
+        using JsonSavable::loadFromJsonFile;
+        bool loadFromJsonFile(const std::string& jsonPath, bool verbose = true) override;
+        
         bool loadOverrideOptions(const Json::Value&);
-        Option checkOverrideOption(const Option& option);
-        Option getOverrideOption(const std::string& name);
+        Option checkOverrideOption(const Option& option) const;
+        Option getOverrideOption(const std::string& name) const;
+        
+        std::vector<std::string> createOptionCommands(const Config& config, const std::vector<Option>& engineOptionList) const;
+        void prepareOptionCommands();
         
 		void setSyzygyPath(const std::string& path);
         std::string getSyzygyPath() const { return syzygyPath; }
@@ -197,9 +216,7 @@ namespace banksia {
         Json::Value createJsonForSaving() override;
         
     private:
-        bool parseJsonAfterLoading(Json::Value&) override;
-        
-        std::map<std::string, Config> configMap;
+        std::map<std::string, ConfigPtr> configMap;
         std::map<std::string, Option> overrideOptions;
 
         bool editingMode = false, overrideOptionMode = false;
@@ -29,6 +29,7 @@
 
 #include "engine.h"
 #include "tourmng.h"
+#include "metrics.h"
 
 using namespace banksia;
 
@@ -55,6 +56,14 @@ void Engine::tickWork()
     tick_state++;
     tick_idle++;
     
+    if (isOutputStalled()) {
+        auto str = name + " stalled, it doesn't read its input. Stopped!";
+        if (messageLogger)
+            (messageLogger)(getAppName(), str, LogType::system);
+        setState(PlayerState::stopped);
+        return;
+    }
+    
     if (isIdleCrash()) {
         auto str = name + " stalled too long. Stopped!";
         if (messageLogger)
@@ -75,9 +84,48 @@ void Engine::tickWork()
         }
     }
     
+    checkStartingLatency();
     tickPing();
 }
 
+void Engine::checkStartingLatency()
+{
+    // called from both the tick and the reading threads, only the one clearing the flag counts the start
+    if (state >= PlayerState::ready && state < PlayerState::stopping && startingMeasured.exchange(false)) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startingClock;
+        metrics.addEngineStart(elapsed.count());
+    }
+}
+
+void Engine::goWritten()
+{
+    std::lock_guard<std::mutex> dolock(outputMutex);
+    
+    // the go is still in the queue, the clock starts when it hits the pipe
+    if (!outputQueue.empty()) {
+        goPending = true;
+        goClockMode = false;
+        return;
+    }
+    goTicks = outputTicks.load();
+    goClockMode = true;
+}
+
+// Time of the engine for the last move: from writing the go command into the pipe
+// to reading the bytes of its move. Delays of the manager (timer, threads, logs) are not charged
+double Engine::moveTimeConsumed(const GameTimeController* timeCtrl) const
+{
+    auto period = timeCtrl->moveTimeConsumed();
+    if (goClockMode) {
+        auto inputClock = getInputClock(), goClock = ticks2Clock(goTicks);
+        if (inputClock > goClock) {
+            std::chrono::duration<double> elapsed = inputClock - goClock;
+            period = std::min(period, elapsed.count());
+        }
+    }
+    return std::max(period, 1e-6);
+}
+
 void Engine::tickPing()
 {
     tick_ping++;
@@ -133,6 +181,8 @@ void Engine::read_stderr(const char *bytes, size_t n)
 
 void Engine::read_stdout(const char *bytes, size_t n)
 {
+    setInputClock(std::chrono::steady_clock::now());
+    
     // check before use since it may be being deleted
     if (!isAttached() || n <= 0) {
         return;
@@ -193,6 +243,7 @@ void Engine::parseLine(const std::string& line)
     
     engineSentCorrectCmds();
     parseLine(it->second, cmdString, line);
+    checkStartingLatency();
 }
 
 bool Engine::kickStart()
@@ -204,11 +255,11 @@ bool Engine::kickStart()
         
 #if (defined _WIN32) && (defined UNICODE)
         std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-        auto command = converter.from_bytes(config.command);
-        auto workingFolder = converter.from_bytes(config.workingFolder);
+        auto command = converter.from_bytes(config->command);
+        auto workingFolder = converter.from_bytes(config->workingFolder);
 #else
-        auto command = config.command;
-        auto workingFolder = config.workingFolder;
+        auto command = config->command;
+        auto workingFolder = config->workingFolder;
 #endif
         
         assert(!command.empty());
@@ -227,9 +278,16 @@ bool Engine::kickStart()
                                                   true, config);
             
             processId = engineProcess.get_id();
+            {
+                std::lock_guard<std::mutex> dolock(outputMutex);
+                outputQueue.clear();
+                outputStalled = goPending = false;
+            }
             process = &engineProcess;
+            startingClock = std::chrono::steady_clock::now();
+            startingMeasured = true;
             setState(PlayerState::starting);
-            write(protocolString());
+            sendProtocol();
 
             engineProcess.get_exit_status();
             
@@ -247,12 +305,65 @@ bool Engine::kickStart()
         return true;
     }
     
-    write(protocolString());
+    sendProtocol();
     return true;
 }
 
+bool Engine::sendProtocol()
+{
+    return write(protocolString());
+}
+
+bool Engine::findHandshake()
+{
+    handshake = Handshake();
+    handshakeHit = handshakeCache.find(config->command, handshake) && handshake.protocol == config->protocol;
+    if (!handshakeHit) {
+        handshake = Handshake();
+        handshake.idName = config->idName;
+        handshake.variantSet = config->variantSet;
+    }
+    return handshakeHit;
+}
+
+// called when the engine has completed the handshake
+void Engine::saveHandshake()
+{
+    if (handshakeHit) {
+        return;
+    }
+    handshake.protocol = config->protocol;
+    if (handshakeCaching) {
+        handshakeCache.update(config->command, handshake);
+    }
+}
+
+// an option the engine has just declared
+void Engine::addEngineOption(const Option& option)
+{
+    if (option.name == "Ponder" && !config->getOption(option.name)) {
+        ponderable = true;
+    }
+    if (!handshakeHit) {
+        handshake.optionList.push_back(option);
+    }
+}
+
+// the config updated by what the engine replied to the handshake
+Config Engine::getHandshakeConfig() const
+{
+    auto c = *config;
+    c.idName = handshake.idName;
+    c.variantSet = handshake.variantSet;
+    for(auto && option : handshake.optionList) {
+        c.updateOption(option);
+    }
+    return c;
+}
+
 void Engine::attach(ChessBoard* board, const GameTimeController* timeController, std::function<void(const Move&, const std::string&, const Move&, double, EngineComputingState)> moveFunc, std::function<void()> resignFunc)
 {
+    std::lock_guard<std::mutex> dolock(attachMutex);
     Player::attach(board, timeController, moveFunc, resignFunc);
     tick_deattach = -1;
     tick_idle = 0;
@@ -283,15 +394,96 @@ bool Engine::isWritable() const
 }
 
 bool Engine::write(const std::string& str)
+{
+    std::string buf;
+    buf.reserve(str.size() + 1);
+    buf += str;
+    buf += '\n';
+    return writeBuffer(buf);
+}
+
+// a group of commands (such as position + go) is joined into one buffer
+// thus it goes to the engine by a single write and the engine won't wake up
+// for an incomplete group
+bool Engine::write(const std::vector<std::string>& cmds)
+{
+    size_t sz = 0;
+    for(auto && s : cmds) {
+        sz += s.size() + 1;
+    }
+    
+    std::string buf;
+    buf.reserve(sz);
+    for(auto && s : cmds) {
+        if (s.empty()) continue;
+        buf += s;
+        buf += '\n';
+    }
+    return buf.empty() || writeBuffer(buf);
+}
+
+bool Engine::writeBuffer(std::string& buf)
 {
     if (state >= PlayerState::starting && state < PlayerState::stopped && process) {
-        process->write(str + "\n");
-        log(str, LogType::toEngine);
+        {
+            std::lock_guard<std::mutex> dolock(outputMutex);
+            if (outputStalled) {
+                return false;
+            }
+            outputQueue += buf;
+            flushOutput();
+            
+            auto limit = static_cast<size_t>(config->writeQueueLimit > 0 ? config->writeQueueLimit : write_queue_limit_default) * 1024;
+            if (outputQueue.size() > limit) {
+                outputStalled = true;
+            }
+        }
+        buf.pop_back(); // the last '\n'
+        log(buf, LogType::toEngine);
         return true;
     }
     return false;
 }
 
+// call with outputMutex locked
+void Engine::flushOutput()
+{
+    auto p = process;
+    if (outputQueue.empty() || !p) {
+        return;
+    }
+    
+    size_t k = 0;
+    while (k < outputQueue.size()) {
+        auto n = p->try_write(outputQueue.c_str() + k, outputQueue.size() - k);
+        if (n < 0) { // broken pipe, the engine is exiting
+            k = outputQueue.size();
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        k += static_cast<size_t>(n);
+    }
+    outputQueue.erase(0, k);
+    
+    if (outputQueue.empty()) {
+        setOutputClock(std::chrono::steady_clock::now());
+        if (goPending) {
+            goPending = false;
+            goTicks = outputTicks.load();
+            goClockMode = true;
+        }
+    }
+}
+
+bool Engine::isOutputStalled()
+{
+    std::lock_guard<std::mutex> dolock(outputMutex);
+    flushOutput();
+    return outputStalled;
+}
+
 bool Engine::sendQuit()
 {
     return write("quit");
@@ -28,12 +28,15 @@
 
 #include <vector>
 #include <set>
+#include <atomic>
+#include <chrono>
 
 #include "../3rdparty/process/process.hpp"
 #include "../chess/chess.h"
 
 #include "player.h"
 #include "configmng.h"
+#include "handshakecache.h"
 
 namespace banksia {
     enum class LogType {
@@ -46,10 +49,11 @@ namespace banksia {
         const int tick_period_ping = 30; // 20s
         const int tick_period_deattach = 6; // 3s
         const int tick_period_idle_dead = 60; // 30s
+        const int write_queue_limit_default = 256; // KB
 
     public:
-        Engine() : Player("", PlayerType::engine) {}
-        Engine(const Config& config) : Player(config.name, PlayerType::engine), config(config) {}
+        Engine() : Player("", PlayerType::engine), config(std::make_shared<const Config>()) {}
+        Engine(const ConfigPtr& config) : Player(config->name, PlayerType::engine), config(config), ponderable(config->ponderable) {}
         virtual ~Engine();
         
         virtual const char* className() const override { return "Engine"; }
@@ -58,6 +62,11 @@ namespace banksia {
         
         virtual void tickWork() override;
         
+        const Handshake& getHandshake() const { return handshake; }
+        Config getHandshakeConfig() const;
+        // off: the handshake is kept but not stored into the cache
+        void setHandshakeCaching(bool mode) { handshakeCaching = mode; }
+        
         void setMessageLogger(std::function<void(const std::string&, const std::string&, LogType logType)> messageLogger);
         
     public:
@@ -91,6 +100,11 @@ namespace banksia {
         virtual void engineSentCorrectCmds();
 
         virtual bool sendPing() = 0;
+        virtual bool sendProtocol();
+        
+        bool findHandshake();
+        void saveHandshake();
+        void addEngineOption(const Option& option);
         
         void read_stdout(const char *bytes, size_t n);
         void read_stderr(const char *bytes, size_t n);
@@ -102,24 +116,55 @@ namespace banksia {
         virtual void finished() {}
         virtual void tickPing();
         
+        void checkStartingLatency();
+        
+        void goWritten();
+        double moveTimeConsumed(const GameTimeController* timeCtrl) const;
+        
+    private:
+        bool writeBuffer(std::string&);
+        void flushOutput();
+        bool isOutputStalled();
+        
     public:
         EngineComputingState computingState = EngineComputingState::idle;
-        Config config;
+        ConfigPtr config; // shared, the engine's replies are kept in handshake
         
     protected:
         bool write(const std::string&);
+        bool write(const std::vector<std::string>&);
         int tick_deattach = -1;
         int tick_ping, tick_idle, tick_being_kill = -1; //, tick_stopping = 0;
         std::function<void(const std::string&, const std::string&, LogType)> messageLogger = nullptr;
 
         int correctCmdCnt = 0;
         TinyProcessLib::Process::id_type processId = 0;
+        
+        // from starting the process to being ready, for metrics
+        std::chrono::steady_clock::time_point startingClock;
+        std::atomic<bool> startingMeasured { false };
+        
+        // when the last go (or ponderhit) hit the pipe, in ticks of steady_clock. Written under
+        // outputMutex, read by the reading thread without it
+        std::atomic<i64> goTicks { 0 };
+        std::atomic<bool> goClockMode { false };
+        
+        // the reply to "uci" / "xboard", from the cache when handshakeHit is true
+        Handshake handshake;
+        bool handshakeHit = false, handshakeCaching = true;
+        bool ponderable = true; // of the config, on when the engine declares the option Ponder
 
     private:
         const int process_buffer_size = 16 * 1024;
         std::string lastIncompletedStdout;
         TinyProcessLib::Process* process = nullptr;
         std::thread* pThread = nullptr;
+        
+        // commands are queued and written without blocking, the rest waits
+        // for the engine to read its pipe and is flushed by later writes and ticks
+        std::mutex outputMutex;
+        std::string outputQueue;
+        bool outputStalled = false, goPending = false;
     };
     
     
@@ -101,7 +101,7 @@ EngineProfile::EngineProfile()
 	resetProfile();
 #endif
 }
-EngineProfile::EngineProfile(const Config& config)
+EngineProfile::EngineProfile(const ConfigPtr& config)
 	: Engine(config)
 {
 #ifdef _WIN32
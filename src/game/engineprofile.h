@@ -67,7 +67,7 @@ namespace banksia {
     {
     public:
         EngineProfile();
-        EngineProfile(const Config& config);
+        EngineProfile(const ConfigPtr& config);
 
         virtual ~EngineProfile();
         
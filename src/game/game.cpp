@@ -28,8 +28,10 @@
 #include <ctime>
 
 #include "game.h"
+#include "pgnwriter.h"
 #include "engine.h"
 #include "tourmng.h"
+#include "metrics.h"
 
 using namespace banksia;
 
@@ -175,6 +177,11 @@ void Game::startThinking(Move pondermove)
     players[sd]->go();
 }
 
+double Game::getOverhead(Side side) const
+{
+    return overhead[static_cast<int>(side)];
+}
+
 void Game::pause()
 {
 }
@@ -201,6 +208,8 @@ void Game::moveFromPlayer(const Move& move, const std::string& moveString, const
     auto sd = static_cast<int>(board.side);
 
     if (oldState == EngineComputingState::thinking) {
+        overhead[sd] += std::max(0.0, timeController.moveTimeConsumed() - timeConsumed);
+        
         if (make(move, moveString)) {
             assert(board.side != side);
             
@@ -212,6 +221,13 @@ void Game::moveFromPlayer(const Move& move, const std::string& moveString, const
             timeController.udateClockAfterMove(timeConsumed, lastHist.move.piece.side, int(board.histList.size()));
             
             startThinking(gameConfig.ponderMode ? ponderMove : Move::illegalMove);
+            
+            // overhead of the manager: from reading the move to sending the go of the opponent
+            auto inputClock = players[sd]->getInputClock(), outputClock = players[1 - sd]->getOutputClock();
+            if (outputClock > inputClock) {
+                std::chrono::duration<double> elapsed = outputClock - inputClock;
+                metrics.moveLatency.add(elapsed.count());
+            }
         }
     } else if (oldState == EngineComputingState::pondering) { // missed ponderhit, stop called
         players[sd]->go();
@@ -222,6 +238,7 @@ bool Game::make(const Move& move, const std::string& moveString)
 {
     if (board.checkMake(move.from, move.dest, move.promotion)) {
         assert(ChessBoard::isValidPromotion(move.promotion));
+        metrics.moveCnt++;
         auto result = board.rule();
         if (result.result != ResultType::noresult) {
             gameOver(result);
@@ -435,68 +452,68 @@ void Game::tickWork()
 
 std::string Game::toPgn(std::string event, std::string site, int round, int gameIdx, bool richMode)
 {
-    std::ostringstream stringStream;
+    PgnWriter writer;
+    toPgn(writer, event, site, round, gameIdx, richMode);
+    return writer.str();
+}
+
+void Game::toPgn(PgnWriter& writer, const std::string& event, const std::string& site, int round, int gameIdx, bool richMode)
+{
+    writer.clear();
     
     if (!event.empty()) {
-        stringStream << "[Event \"" << event << "\"]" << std::endl;
+        writer.addTag("Event", event);
     }
     if (!site.empty()) {
-        stringStream << "[Site \"" << site << "\"]" << std::endl;
+        writer.addTag("Site", site);
     }
     
     auto tm = localtime_xp(std::time(0));
     
-    stringStream << "[Date \"" << std::put_time(&tm, "%Y.%m.%d") << "\"]" << std::endl;
+    writer.addTimeTag("Date", "%Y.%m.%d", tm);
     
     if (round >= 0) {
-        stringStream << "[Round \"" << round << "\"]" << std::endl;
+        writer.addTag("Round", round);
     }
     
     for(int sd = 1; sd >= 0; sd--) {
         if (players[sd]) {
-            stringStream << "[" << (sd == W ? "White \"" : "Black \"") << players[sd]->getName() << "\"]" << std::endl;
+            writer.addTag(sd == W ? "White" : "Black", players[sd]->getName());
         }
     }
-    stringStream << "[Result \"" << board.result.toShortString() << "\"]" << std::endl;
+    writer.addTag("Result", board.result.toShortString());
     
-    stringStream << "[TimeControl \"" << timeController.toString() << "\"]" << std::endl;
+    writer.addTag("TimeControl", timeController.toString());
     
-    stringStream << "[Time \"" << std::put_time(&tm, "%H:%M:%S") << "\"]" << std::endl;
+    writer.addTimeTag("Time", "%H:%M:%S", tm);
     
     if (gameIdx >= 0) {
-        stringStream << "[Board \"" << std::to_string(gameIdx + 1) << "\"]" << std::endl;
+        writer.addTag("Board", gameIdx + 1);
     }
-
+    
     auto str = board.result.reasonString();
     if (!str.empty()) {
-        stringStream << "[Termination \"" << str << "\"]" << std::endl;
+        writer.addTag("Termination", str);
     }
-
+    
     if (!board.fromOriginPosition()) {
-        stringStream << "[FEN \"" << board.getStartingFen() << "\"]" << std::endl;
-        stringStream << "[SetUp \"1\"]" << std::endl;
+        writer.addTag("FEN", board.getStartingFen());
+        writer.addTag("SetUp", 1);
     }
-
+    
     auto ecoVec = board.commentEcoString();
-
+    
     if (ecoVec.size() > 1) {
-        stringStream << "[ECO \"" << ecoVec.front() << "\"]" << std::endl;
-        stringStream << "[Opening \"" << ecoVec.at(1) << "\"]" << std::endl;
+        writer.addTag("ECO", ecoVec.front());
+        writer.addTag("Opening", ecoVec.at(1));
         if (ecoVec.size() > 2) {
-            stringStream << "[Variation \"" << ecoVec.at(2) << "\"]" << std::endl;
+            writer.addTag("Variation", ecoVec.at(2));
         }
     }
-
-    // Move text
-    stringStream << "\n" << board.toMoveListString(MoveNotation::san, richMode ? 4 : 8, true, richMode);
     
-    if (board.result.result != ResultType::noresult) {
-        if (board.histList.size() % 8 != 0) stringStream << " ";
-        stringStream << board.result.toShortString() << std::endl;
-    }
-    stringStream << std::endl;
-    
-    return stringStream.str();
+    // Move text
+    writer.addMoveText(board, richMode);
+    writer.addResult(board);
 }
 
 
@@ -26,12 +26,16 @@
 #ifndef game_hpp
 #define game_hpp
 
+#include <atomic>
+
 #include "../chess/chess.h"
 #include "engine.h"
 
 
 namespace banksia {
     
+    class PgnWriter;
+    
     enum class GameState {
         none, begin,
         ready, playing, stopped, // playing
@@ -93,12 +97,19 @@ namespace banksia {
         int getStateTick() const { return stateTick; }
         
         std::string toPgn(std::string event = "", std::string site = "", int round = -1, int gameIdx = -1, bool richMode = false);
+        void toPgn(PgnWriter& writer, const std::string& event, const std::string& site, int round, int gameIdx, bool richMode);
         
         std::string getGameTitleString(bool includeResult = false) const;
         
+        // time not charged to engines (the manager's delays), unit: second
+        double getOverhead(Side side) const;
+        
     public:
         ChessBoard board;
         
+        // set while a worker thread of the tournament manager is ticking the game
+        std::atomic<bool> scheduled { false };
+        
     private:
         bool checkTimeOver();
         
@@ -115,6 +126,8 @@ namespace banksia {
         std::string startFen;
         std::vector<Move> startMoves;
         std::mutex criticalMutex;
+        
+        double overhead[2] = { 0, 0 };
     };
     
 } // namespace banksia
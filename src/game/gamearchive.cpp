@@ -0,0 +1,683 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "gamearchive.h"
+#include "pgnwriter.h"
+#include "book.h"
+
+using namespace banksia;
+
+static const char archiveSignature[8] = { 'B', 'K', 'S', 'A', 'R', 'C', '1', 0 };
+static const size_t archiveBlockSize = 64 * 1024;
+static const size_t archiveHeaderSize = 12, archiveIndexEntrySize = 16;
+
+enum {
+    recordInfo = 1, recordPlayer = 2, recordFen = 3, recordGame = 4
+};
+
+//////////////////////////////////////////////////////////////////////
+// LZ4 block format: sequences of a token (4 bits literal length, 4 bits match length - 4),
+// extra length bytes, literals, 2 bytes offset, extra match length bytes. The last sequence
+// has literals only
+
+static void putLength(std::string& out, size_t len)
+{
+    while (len >= 255) {
+        out += static_cast<char>(255);
+        len -= 255;
+    }
+    out += static_cast<char>(len);
+}
+
+static void putSequence(std::string& out, const u8* literals, size_t literalLen, size_t offset, size_t matchLen)
+{
+    auto m = matchLen ? matchLen - 4 : 0;
+    out += static_cast<char>((std::min<size_t>(literalLen, 15) << 4) | std::min<size_t>(m, 15));
+    if (literalLen >= 15) {
+        putLength(out, literalLen - 15);
+    }
+    out.append(reinterpret_cast<const char*>(literals), literalLen);
+    
+    if (matchLen) {
+        out += static_cast<char>(offset & 0xff);
+        out += static_cast<char>(offset >> 8);
+        if (m >= 15) {
+            putLength(out, m - 15);
+        }
+    }
+}
+
+static u32 read32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static void lzCompress(const u8* src, size_t n, std::string& out)
+{
+    const int hashLog = 14;
+    std::vector<int> table(1 << hashLog, -1);
+    
+    size_t i = 0, anchor = 0;
+    // the last match must start 12 bytes before the end, the last 5 bytes are literals
+    auto matchLimit = n > 12 ? n - 12 : 0;
+    while (i < matchLimit) {
+        auto seq = read32(src + i);
+        auto h = (seq * 2654435761U) >> (32 - hashLog);
+        auto ref = table[h];
+        table[h] = static_cast<int>(i);
+        
+        if (ref < 0 || i - ref > 65535 || read32(src + ref) != seq) {
+            i++;
+            continue;
+        }
+        
+        size_t len = 4;
+        while (i + len < n - 5 && src[ref + len] == src[i + len]) {
+            len++;
+        }
+        putSequence(out, src + anchor, i - anchor, i - ref, len);
+        i += len;
+        anchor = i;
+    }
+    putSequence(out, src + anchor, n - anchor, 0, 0);
+}
+
+static bool lzDecompress(const u8* src, size_t n, std::string& out, size_t rawSize)
+{
+    out.clear();
+    out.reserve(rawSize);
+    
+    auto p = src, end = src + n;
+    while (p < end) {
+        auto token = *p++;
+        size_t literalLen = token >> 4;
+        if (literalLen == 15) {
+            u8 b;
+            do {
+                if (p >= end) return false;
+                b = *p++;
+                literalLen += b;
+            } while (b == 255);
+        }
+        if (literalLen > static_cast<size_t>(end - p)) return false;
+        out.append(reinterpret_cast<const char*>(p), literalLen);
+        p += literalLen;
+        
+        if (p >= end) {
+            break; // the last sequence
+        }
+        
+        if (end - p < 2) return false;
+        size_t offset = p[0] | p[1] << 8;
+        p += 2;
+        size_t matchLen = (token & 0xf) + 4;
+        if ((token & 0xf) == 15) {
+            u8 b;
+            do {
+                if (p >= end) return false;
+                b = *p++;
+                matchLen += b;
+            } while (b == 255);
+        }
+        if (offset == 0 || offset > out.size() || out.size() + matchLen > rawSize) return false;
+        
+        // may overlap, copy byte by byte
+        auto k = out.size() - offset;
+        for(size_t j = 0; j < matchLen; j++) {
+            out += out[k + j];
+        }
+    }
+    return out.size() == rawSize;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Little-endian numbers, varints (signed ones zigzag) and strings
+
+static void putU32(std::string& s, u32 v)
+{
+    for(int i = 0; i < 4; i++) {
+        s += static_cast<char>(v >> (i * 8));
+    }
+}
+
+static void putVarint(std::string& s, u64 v)
+{
+    while (v >= 0x80) {
+        s += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    s += static_cast<char>(v);
+}
+
+static void putSigned(std::string& s, i64 v)
+{
+    putVarint(s, (static_cast<u64>(v) << 1) ^ static_cast<u64>(v >> 63));
+}
+
+static void putString(std::string& s, const std::string& str)
+{
+    putVarint(s, str.size());
+    s += str;
+}
+
+class ArchiveReader {
+public:
+    ArchiveReader(const std::string& data) : p(reinterpret_cast<const u8*>(data.c_str())), end(p + data.size()) {}
+    
+    bool ok = true;
+    
+    bool atEnd() const {
+        return p >= end;
+    }
+    
+    u8 byte() {
+        if (p >= end) {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+    
+    u64 fixed(int len) {
+        u64 v = 0;
+        for(int i = 0; i < len; i++) {
+            v |= static_cast<u64>(byte()) << (i * 8);
+        }
+        return v;
+    }
+    
+    u64 varint() {
+        u64 v = 0;
+        for(int shift = 0; shift < 64 && ok; shift += 7) {
+            auto b = byte();
+            v |= static_cast<u64>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        return v;
+    }
+    
+    i64 signedVarint() {
+        auto v = varint();
+        return static_cast<i64>(v >> 1) ^ -static_cast<i64>(v & 1);
+    }
+    
+    std::string string() {
+        auto len = varint();
+        if (len > static_cast<u64>(end - p)) {
+            ok = false;
+            return "";
+        }
+        std::string str(reinterpret_cast<const char*>(p), len);
+        p += len;
+        return str;
+    }
+    
+private:
+    const u8 *p, *end;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+void ArchiveGame::setBoard(const ChessBoard& board)
+{
+    result = board.result.result;
+    reason = board.result.reason;
+    startFen = board.fromOriginPosition() ? "" : board.getStartingFen();
+    
+    moves.clear();
+    moves.reserve(board.histList.size());
+    for(auto && hist : board.histList) {
+        ArchiveMove m;
+        m.move = BookPgn::packMove(hist.move);
+        m.score = hist.score;
+        m.depth = hist.depth;
+        m.elapsed = static_cast<int>(hist.elapsed * 1000 + 0.5);
+        moves.push_back(m);
+    }
+}
+
+static bool truncateFile(FILE* file, u64 size)
+{
+    fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// A crash may leave a partial block (or a block without its index entries) at the end of the archive
+// and a partial entry at the end of the index. Cut both back to the last block whose entries and data
+// are complete, otherwise blocks appended later would be unreachable
+static void cutPartialTail(FILE* file, const std::string& path)
+{
+    fseek(file, 0, SEEK_END);
+    auto fileSize = static_cast<u64>(ftell(file));
+    
+    std::string index;
+    auto indexPath = path + ".idx";
+    auto indexFile = fopen(indexPath.c_str(), "r+b");
+    if (indexFile) {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), indexFile)) > 0) {
+            index.append(buf, n);
+        }
+    }
+    
+    auto entryCnt = index.size() / archiveIndexEntrySize;
+    u64 validEnd = sizeof(archiveSignature);
+    for(; entryCnt > 0; entryCnt--) {
+        auto entry = reinterpret_cast<const u8*>(index.c_str()) + (entryCnt - 1) * archiveIndexEntrySize;
+        auto blockOffset = static_cast<u64>(read32(entry + 8)) | static_cast<u64>(read32(entry + 12)) << 32;
+        
+        u8 header[archiveHeaderSize];
+        if (blockOffset + archiveHeaderSize <= fileSize
+            && fseek(file, static_cast<long>(blockOffset), SEEK_SET) == 0
+            && fread(header, 1, sizeof(header), file) == sizeof(header)
+            && blockOffset + archiveHeaderSize + read32(header + 4) <= fileSize) {
+            validEnd = blockOffset + archiveHeaderSize + read32(header + 4);
+            break;
+        }
+    }
+    
+    if (fileSize > validEnd) {
+        std::cerr << "Warning: the game archive " << path << " has " << fileSize - validEnd << " bytes of a partial block at its end, cut them off" << std::endl;
+        if (!truncateFile(file, validEnd)) {
+            std::cerr << "Error: cannot truncate the game archive " << path << std::endl;
+        }
+    }
+    
+    if (indexFile) {
+        if (index.size() > entryCnt * archiveIndexEntrySize && !truncateFile(indexFile, entryCnt * archiveIndexEntrySize)) {
+            std::cerr << "Error: cannot truncate the index file " << indexPath << std::endl;
+        }
+        fclose(indexFile);
+    }
+    fseek(file, 0, SEEK_END);
+}
+
+GameArchive::~GameArchive()
+{
+    close();
+}
+
+bool GameArchive::open(const std::string& _path, const std::string& _event, const std::string& _site, const std::string& _timeControl)
+{
+    close();
+    
+    file = fopen(_path.c_str(), "a+b");
+    if (file == nullptr) {
+        std::cerr << "Error: cannot open the game archive " << _path << std::endl;
+        return false;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        fwrite(archiveSignature, 1, sizeof(archiveSignature), file);
+    } else {
+        char signature[sizeof(archiveSignature)];
+        fseek(file, 0, SEEK_SET);
+        if (fread(signature, 1, sizeof(signature), file) != sizeof(signature) || memcmp(signature, archiveSignature, sizeof(signature))) {
+            std::cerr << "Error: " << _path << " is not a game archive" << std::endl;
+            fclose(file);
+            file = nullptr;
+            return false;
+        }
+        cutPartialTail(file, _path);
+    }
+    
+    indexFile = fopen((_path + ".idx").c_str(), "ab");
+    
+    path = _path; event = _event; site = _site; timeControl = _timeControl;
+    beginBlock();
+    return true;
+}
+
+void GameArchive::beginBlock()
+{
+    block.clear();
+    blockGameCnt = 0;
+    blockIndex.clear();
+    playerMap.clear();
+    fenMap.clear();
+    
+    block += static_cast<char>(recordInfo);
+    putString(block, event);
+    putString(block, site);
+    putString(block, timeControl);
+}
+
+int GameArchive::getId(std::unordered_map<std::string, int>& map, u8 recordType, const std::string& str)
+{
+    auto it = map.find(str);
+    if (it != map.end()) {
+        return it->second;
+    }
+    
+    auto id = static_cast<int>(map.size());
+    map[str] = id;
+    block += static_cast<char>(recordType);
+    putVarint(block, id);
+    putString(block, str);
+    return id;
+}
+
+void GameArchive::add(const ArchiveGame& game)
+{
+    if (file == nullptr) {
+        return;
+    }
+    
+    auto whiteId = getId(playerMap, recordPlayer, game.names[W]);
+    auto blackId = getId(playerMap, recordPlayer, game.names[B]);
+    auto fenId = getId(fenMap, recordFen, game.startFen);
+    
+    blockIndex.push_back(std::make_pair(game.gameIdx, static_cast<u32>(block.size())));
+    
+    block += static_cast<char>(recordGame);
+    putVarint(block, game.gameIdx + 1);
+    putVarint(block, game.round + 1);
+    block += static_cast<char>(game.result);
+    block += static_cast<char>(game.reason);
+    putSigned(block, game.time);
+    putVarint(block, whiteId);
+    putVarint(block, blackId);
+    putVarint(block, fenId);
+    for(int i = 0; i < 8; i++) {
+        block += static_cast<char>(game.openingKey >> (i * 8));
+    }
+    
+    putVarint(block, game.moves.size());
+    for(auto && m : game.moves) {
+        block += static_cast<char>(m.move & 0xff);
+        block += static_cast<char>(m.move >> 8);
+        putSigned(block, m.score);
+        putVarint(block, std::max(0, m.depth));
+        putVarint(block, std::max(0, m.elapsed));
+    }
+    
+    blockGameCnt++;
+    if (block.size() >= archiveBlockSize) {
+        flush();
+    }
+}
+
+void GameArchive::flush()
+{
+    if (file == nullptr || blockGameCnt == 0) {
+        return;
+    }
+    
+    std::string data;
+    lzCompress(reinterpret_cast<const u8*>(block.c_str()), block.size(), data);
+    
+    // not compressible
+    if (data.size() >= block.size()) {
+        data = block;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    auto blockOffset = static_cast<u64>(ftell(file));
+    
+    std::string header;
+    putU32(header, static_cast<u32>(block.size()));
+    putU32(header, static_cast<u32>(data.size()));
+    putU32(header, static_cast<u32>(blockGameCnt));
+    fwrite(header.c_str(), 1, header.size(), file);
+    fwrite(data.c_str(), 1, data.size(), file);
+    fflush(file);
+    
+    if (indexFile) {
+        std::string index;
+        for(auto && e : blockIndex) {
+            putU32(index, static_cast<u32>(e.first));
+            putU32(index, e.second);
+            putU32(index, static_cast<u32>(blockOffset));
+            putU32(index, static_cast<u32>(blockOffset >> 32));
+        }
+        fwrite(index.c_str(), 1, index.size(), indexFile);
+        fflush(indexFile);
+    }
+    
+    beginBlock();
+}
+
+void GameArchive::close()
+{
+    flush();
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    if (indexFile) {
+        fclose(indexFile);
+        indexFile = nullptr;
+    }
+}
+
+bool GameArchive::convertToPgn(const std::string& archivePath, const std::string& pgnPath)
+{
+    auto in = fopen(archivePath.c_str(), "rb");
+    if (in == nullptr) {
+        std::cerr << "Error: cannot open the game archive " << archivePath << std::endl;
+        return false;
+    }
+    
+    char signature[sizeof(archiveSignature)];
+    if (fread(signature, 1, sizeof(signature), in) != sizeof(signature) || memcmp(signature, archiveSignature, sizeof(signature))) {
+        std::cerr << "Error: " << archivePath << " is not a game archive" << std::endl;
+        fclose(in);
+        return false;
+    }
+    
+    auto out = fopen(pgnPath.c_str(), "wb");
+    if (out == nullptr) {
+        std::cerr << "Error: cannot create the PGN file " << pgnPath << std::endl;
+        fclose(in);
+        return false;
+    }
+    std::vector<char> outBuffer(1024 * 1024);
+    setvbuf(out, outBuffer.data(), _IOFBF, outBuffer.size());
+    
+    auto ok = true;
+    i64 gameCnt = 0;
+    std::string data, block;
+    PgnWriter writer;
+    ChessBoard board;
+    
+    while (true) {
+        u8 header[archiveHeaderSize];
+        auto n = fread(header, 1, sizeof(header), in);
+        if (n == 0) {
+            break;
+        }
+        if (n != sizeof(header)) {
+            ok = false;
+            break;
+        }
+        
+        auto rawSize = read32(header), storedSize = read32(header + 4);
+        data.resize(storedSize);
+        if (fread(&data[0], 1, storedSize, in) != storedSize) {
+            ok = false;
+            break;
+        }
+        if (storedSize == rawSize) {
+            block.swap(data);
+        } else if (!lzDecompress(reinterpret_cast<const u8*>(data.c_str()), data.size(), block, rawSize)) {
+            ok = false;
+            break;
+        }
+        
+        std::string event, site, timeControl;
+        std::vector<std::string> players, fens;
+        
+        ArchiveReader reader(block);
+        while (reader.ok && !reader.atEnd()) {
+            auto recordType = reader.byte();
+            switch (recordType) {
+                case recordInfo:
+                    event = reader.string();
+                    site = reader.string();
+                    timeControl = reader.string();
+                    break;
+                    
+                case recordPlayer:
+                case recordFen:
+                {
+                    auto& vec = recordType == recordPlayer ? players : fens;
+                    auto id = reader.varint();
+                    auto str = reader.string();
+                    if (id != vec.size()) {
+                        reader.ok = false;
+                        break;
+                    }
+                    vec.push_back(str);
+                    break;
+                }
+                    
+                case recordGame:
+                {
+                    auto gameIdx = static_cast<int>(reader.varint()) - 1;
+                    auto round = static_cast<int>(reader.varint()) - 1;
+                    auto result = static_cast<ResultType>(reader.byte());
+                    auto reason = static_cast<ReasonType>(reader.byte());
+                    auto time = static_cast<std::time_t>(reader.signedVarint());
+                    auto whiteId = reader.varint(), blackId = reader.varint(), fenId = reader.varint();
+                    reader.fixed(8); // opening key
+                    auto moveCnt = reader.varint();
+                    
+                    if (!reader.ok || whiteId >= players.size() || blackId >= players.size() || fenId >= fens.size()
+                        || result > ResultType::loss || reason > ReasonType::crash) {
+                        reader.ok = false;
+                        break;
+                    }
+                    
+                    board.newGame(fens[fenId]);
+                    board.histList.clear();
+                    auto legal = true;
+                    for(u64 i = 0; i < moveCnt && reader.ok; i++) {
+                        u16 packedMove = static_cast<u16>(reader.fixed(2));
+                        auto score = static_cast<int>(reader.signedVarint());
+                        auto depth = static_cast<int>(reader.varint());
+                        auto elapsed = static_cast<int>(reader.varint());
+                        
+                        auto move = BookPgn::unpackMove(packedMove);
+                        if (legal && board.checkMake(move.from, move.dest, move.promotion)) {
+                            auto& hist = board.histList.back();
+                            hist.score = score;
+                            hist.depth = depth;
+                            hist.elapsed = elapsed / 1000.0;
+                        } else {
+                            legal = false;
+                        }
+                    }
+                    if (!reader.ok) {
+                        break;
+                    }
+                    if (!legal) {
+                        std::cerr << "Warning: game " << gameIdx + 1 << " has an illegal move, cut there" << std::endl;
+                    }
+                    board.result = Result(result, reason);
+                    
+                    writer.clear();
+                    if (!event.empty()) {
+                        writer.addTag("Event", event);
+                    }
+                    if (!site.empty()) {
+                        writer.addTag("Site", site);
+                    }
+                    auto tm = localtime_xp(time);
+                    writer.addTimeTag("Date", "%Y.%m.%d", tm);
+                    if (round >= 0) {
+                        writer.addTag("Round", round);
+                    }
+                    writer.addTag("White", players[whiteId]);
+                    writer.addTag("Black", players[blackId]);
+                    writer.addTag("Result", board.result.toShortString());
+                    writer.addTag("TimeControl", timeControl);
+                    writer.addTimeTag("Time", "%H:%M:%S", tm);
+                    if (gameIdx >= 0) {
+                        writer.addTag("Board", gameIdx + 1);
+                    }
+                    auto str = board.result.reasonString();
+                    if (!str.empty()) {
+                        writer.addTag("Termination", str);
+                    }
+                    if (!board.fromOriginPosition()) {
+                        writer.addTag("FEN", board.getStartingFen());
+                        writer.addTag("SetUp", 1);
+                    }
+                    auto ecoVec = board.commentEcoString();
+                    if (ecoVec.size() > 1) {
+                        writer.addTag("ECO", ecoVec.front());
+                        writer.addTag("Opening", ecoVec.at(1));
+                        if (ecoVec.size() > 2) {
+                            writer.addTag("Variation", ecoVec.at(2));
+                        }
+                    }
+                    writer.addMoveText(board, true);
+                    writer.addResult(board);
+                    
+                    fwrite(writer.str().c_str(), 1, writer.str().size(), out);
+                    fputc('\n', out);
+                    gameCnt++;
+                    break;
+                }
+                    
+                default:
+                    reader.ok = false;
+                    break;
+            }
+        }
+        
+        if (!reader.ok) {
+            ok = false;
+            break;
+        }
+    }
+    
+    fclose(in);
+    fclose(out);
+    
+    if (!ok) {
+        std::cerr << "Error: the game archive " << archivePath << " is corrupted" << std::endl;
+    }
+    std::cout << "Converted " << gameCnt << " games into " << pgnPath << std::endl;
+    return ok;
+}
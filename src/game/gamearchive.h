@@ -0,0 +1,99 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef gamearchive_h
+#define gamearchive_h
+
+#include <stdio.h>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../chess/chess.h"
+
+namespace banksia {
+    
+    class ArchiveMove {
+    public:
+        u16 move; // packed as BookPgn::packMove
+        int score, depth;
+        int elapsed; // ms
+    };
+    
+    // A completed game to be archived
+    class ArchiveGame {
+    public:
+        void setBoard(const ChessBoard& board);
+        
+        int gameIdx = -1, round = -1;
+        ResultType result = ResultType::noresult;
+        ReasonType reason = ReasonType::noreason;
+        i64 time = 0;
+        std::string names[2];
+        std::string startFen; // empty for the origin position
+        u64 openingKey = 0;
+        std::vector<ArchiveMove> moves;
+    };
+    
+    // A binary, compressed file of games. It starts with a signature, then blocks:
+    //   u32 raw size, u32 stored size (equal to raw size if not compressed), u32 number of games, data
+    // Data of a block is compressed by an LZ4 block format coder. A block is independent, it has
+    // its own tables of players and starting positions (given as ids in game records).
+    // The index file (path + ".idx") has one entry per game:
+    //   u32 game index, u32 offset of the record in the raw block, u64 offset of the block in the file
+    // A block is written before its index entries. When an archive is opened again, anything after
+    // the last block listed in the index (left by a crash) is cut off before appending
+    class GameArchive
+    {
+    public:
+        ~GameArchive();
+        
+        bool open(const std::string& path, const std::string& event, const std::string& site, const std::string& timeControl);
+        void add(const ArchiveGame& game);
+        // write the current block
+        void flush();
+        void close();
+        
+        static bool convertToPgn(const std::string& archivePath, const std::string& pgnPath);
+        
+    private:
+        void beginBlock();
+        int getId(std::unordered_map<std::string, int>& map, u8 recordType, const std::string& str);
+        
+    private:
+        std::string path, event, site, timeControl;
+        FILE* file = nullptr;
+        FILE* indexFile = nullptr;
+        
+        std::string block;
+        int blockGameCnt = 0;
+        std::vector<std::pair<int, u32>> blockIndex;
+        std::unordered_map<std::string, int> playerMap, fenMap;
+    };
+    
+} // namespace banksia
+
+#endif /* gamearchive_h */
@@ -0,0 +1,194 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <sstream>
+
+#include "handshakecache.h"
+
+namespace banksia {
+    HandshakeCache handshakeCache;
+}
+
+using namespace banksia;
+
+#ifdef _WIN32
+const std::string handshakeCachePath = "handshakes.json";
+#else
+const std::string handshakeCachePath = "./handshakes.json";
+#endif
+
+std::string Handshake::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << nameFromProtocol(protocol) << ", " << idName << ", options: " << optionList.size();
+    return stringStream.str();
+}
+
+bool Handshake::load(const Json::Value& obj)
+{
+    modified = obj["modified"].asInt64();
+    size = obj["size"].asInt64();
+    protocol = protocolFromString(obj["protocol"].asString());
+    idName = obj["id name"].asString();
+    
+    optionList.clear();
+    for(auto && v : obj["options"]) {
+        Option option(v);
+        if (option.isValid()) {
+            optionList.push_back(option);
+        }
+    }
+    
+    variantSet.clear();
+    for(auto && v : obj["variants"]) {
+        variantSet.insert(v.asString());
+    }
+    
+    featureMap.clear();
+    auto features = obj["features"];
+    for(auto && name : features.getMemberNames()) {
+        featureMap[name] = features[name].asString();
+    }
+    doneDelayed = obj["done delayed"].asBool();
+    return isValid();
+}
+
+Json::Value Handshake::saveToJson() const
+{
+    Json::Value obj;
+    obj["modified"] = modified;
+    obj["size"] = size;
+    obj["protocol"] = nameFromProtocol(protocol);
+    obj["id name"] = idName;
+    
+    if (!optionList.empty()) {
+        Json::Value array;
+        for(auto && option : optionList) {
+            array.append(option.saveToJson());
+        }
+        obj["options"] = array;
+    }
+    
+    if (!variantSet.empty()) {
+        Json::Value array;
+        for(auto && s : variantSet) {
+            array.append(s);
+        }
+        obj["variants"] = array;
+    }
+    
+    if (protocol == Protocol::wb) {
+        Json::Value features;
+        for(auto && p : featureMap) {
+            features[p.first] = p.second;
+        }
+        obj["features"] = features;
+        obj["done delayed"] = doneDelayed;
+    }
+    return obj;
+}
+
+HandshakeCache* HandshakeCache::instance = nullptr;
+
+HandshakeCache::HandshakeCache()
+{
+    assert(!instance);
+    instance = this;
+    jsonPath = handshakeCachePath;
+}
+
+std::string HandshakeCache::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << "handshakes: " << handshakeMap.size();
+    return stringStream.str();
+}
+
+bool HandshakeCache::find(const std::string& path, Handshake& handshake)
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    auto it = handshakeMap.find(path);
+    if (it == handshakeMap.end()
+        || it->second.modified != getFileModifiedTime(path)
+        || it->second.size != getFileSize(path)) {
+        return false;
+    }
+    handshake = it->second;
+    return true;
+}
+
+void HandshakeCache::update(const std::string& path, const Handshake& handshake)
+{
+    auto h = handshake;
+    h.modified = getFileModifiedTime(path);
+    h.size = getFileSize(path);
+    if (path.empty() || !h.isValid()) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> dolock(mutex);
+    handshakeMap[path] = h;
+    dirty = true;
+}
+
+bool HandshakeCache::load()
+{
+    return loadFromJsonFile(handshakeCachePath, false);
+}
+
+bool HandshakeCache::save()
+{
+    {
+        std::lock_guard<std::mutex> dolock(mutex);
+        if (!dirty) {
+            return true;
+        }
+        dirty = false;
+    }
+    return saveToJsonFile();
+}
+
+bool HandshakeCache::parseJsonAfterLoading(Json::Value& obj)
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    handshakeMap.clear();
+    for(auto && path : obj.getMemberNames()) {
+        Handshake handshake;
+        if (handshake.load(obj[path])) {
+            handshakeMap[path] = handshake;
+        }
+    }
+    return true;
+}
+
+Json::Value HandshakeCache::createJsonForSaving()
+{
+    std::lock_guard<std::mutex> dolock(mutex);
+    Json::Value obj;
+    for(auto && p : handshakeMap) {
+        obj[p.first] = p.second.saveToJson();
+    }
+    return obj;
+}
@@ -0,0 +1,99 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef handshakecache_h
+#define handshakecache_h
+
+#include <map>
+#include <set>
+#include <mutex>
+
+#include "configmng.h"
+
+namespace banksia {
+    
+    // What an engine replied to the protocol handshake ("uci" / "xboard"), protocol none
+    // for binaries which are not engines
+    class Handshake : public Jsonable
+    {
+    public:
+        virtual const char* className() const override { return "Handshake"; }
+        virtual bool isValid() const override { return size > 0; }
+        virtual std::string toString() const override;
+        
+        virtual bool load(const Json::Value& obj) override;
+        virtual Json::Value saveToJson() const override;
+        
+        // the binary was checked but it is not an engine
+        bool isEngine() const { return protocol != Protocol::none; }
+        
+    public:
+        i64 modified = 0, size = 0; // of the binary file
+        Protocol protocol = Protocol::none;
+        std::string idName;
+        std::vector<Option> optionList;
+        std::set<std::string> variantSet;
+        
+        // for Winboard only
+        std::map<std::string, std::string> featureMap;
+        bool doneDelayed = false; // the engine sent "feature done=0"
+    };
+    
+    // Handshakes of engines, keyed by binary paths, valid while their modified times and sizes
+    // are unchanged. Engines with a hit don't wait for their option lists before setting up
+    class HandshakeCache : public Obj, public JsonSavable
+    {
+    public:
+        HandshakeCache();
+        virtual ~HandshakeCache() {}
+        
+        static HandshakeCache* instance;
+        
+        virtual const char* className() const override { return "HandshakeCache"; }
+        virtual bool isValid() const override { return true; }
+        virtual std::string toString() const override;
+        
+        bool find(const std::string& path, Handshake& handshake);
+        void update(const std::string& path, const Handshake& handshake);
+        
+        bool load();
+        bool save();
+        
+    protected:
+        virtual Json::Value createJsonForSaving() override;
+        
+    private:
+        virtual bool parseJsonAfterLoading(Json::Value&) override;
+        
+        std::mutex mutex;
+        std::map<std::string, Handshake> handshakeMap;
+        bool dirty = false;
+    };
+    
+    extern HandshakeCache handshakeCache;
+    
+} // namespace banksia
+
+#endif /* handshakecache_h */
@@ -39,25 +39,34 @@ JsonEngine::~JsonEngine()
 }
 
 JsonEngine::JsonEngine(const Config& config)
-: Engine(config)
+: Engine(std::make_shared<const Config>(config))
 {
     assert(!config.command.empty());
     
     originalProtocol = config.protocol;
     if (config.protocol == Protocol::none) {
-        this->config.protocol = Protocol::uci;
+        setProtocol(Protocol::uci);
     }
 }
 
+// configs are immutable, the probing one is replaced by a new snapshot
+void JsonEngine::setProtocol(Protocol protocol)
+{
+    auto c = std::make_shared<Config>(*config);
+    c->protocol = protocol;
+    config = c;
+}
+
 void JsonEngine::setupEngine()
 {
-    if (config.protocol == Protocol::uci) {
+    if (config->protocol == Protocol::uci) {
         engine = &uciEngine;
     } else {
         engine = &wbEngine;
     }
     
     engine->config = config;
+    engine->setHandshakeCaching(false); // by JsonMaker, for the winner of probes
     engine->setState(PlayerState::starting);
 }
 
@@ -104,18 +113,45 @@ const std::unordered_map<std::string, int>& JsonEngine::getEngineCmdMap() const
 
 void JsonEngine::parseLine(int cmdInt, const std::string& cmdString, const std::string& line)
 {
-    if (cmdInt >= 0) {
+    lineCnt++;
+    if (cmdInt >= 0 && jsonstate == JsonEngineState::working) {
         usedCmdSet.insert(cmdString);
         engine->parseLine(cmdInt, cmdString, line);
+        
+        // uciok or feature done=1, don't wait for the next tick
+        if (engine->getState() == PlayerState::ready && correctCmdCnt > 0) {
+            succeeded();
+        }
     }
 }
 
-void JsonEngine::completed(Config* config)
+void JsonEngine::finished()
 {
+    completed(nullptr, true);
+}
+
+void JsonEngine::cancel()
+{
+    completed(nullptr);
+}
+
+// the callback gets the config updated by the engine's handshake
+void JsonEngine::succeeded()
+{
+    auto c = engine->getHandshakeConfig();
+    completed(&c);
+}
+
+void JsonEngine::completed(Config* config, bool _rejected)
+{
+    auto st = JsonEngineState::working;
+    if (!jsonstate.compare_exchange_strong(st, JsonEngineState::done)) {
+        return;
+    }
+    rejected = _rejected;
     (taskComplete)(config);
     quit();
     kill();
-    jsonstate = JsonEngineState::done;
 }
 
 void JsonEngine::tickWork()
@@ -128,19 +164,19 @@ void JsonEngine::tickWork()
     
     auto st = engine->getState();
     if (st == PlayerState::stopped) {
-        return completed(nullptr);
+        return completed(nullptr, true);
     }
     
     if (st == PlayerState::ready) {
         if (correctCmdCnt == 0) { // hm, wait for a pong (in case of wb)
             return;
         }
-        completed(&engine->config);
+        succeeded();
         return;
     }
     
     // wb need tickWork to turn ready
-    if (config.protocol == Protocol::wb) {
+    if (config->protocol == Protocol::wb) {
         engine->tickWork();
     }
     
@@ -150,7 +186,7 @@ void JsonEngine::tickWork()
     }
     
     if ((correctCmdCnt > 6 && usedCmdSet.size() > 2) || (correctCmdCnt > 3 && usedCmdSet.find("feature") != usedCmdSet.end())) {
-        completed(&engine->config);
+        succeeded();
         return;
     }
     
@@ -160,18 +196,20 @@ void JsonEngine::tickWork()
         return;
     }
     
-    if (originalProtocol != Protocol::none || config.protocol == Protocol::wb) {
-        completed(nullptr);
+    // time out: it is not an engine only when it talked but never with the protocol
+    if (originalProtocol != Protocol::none || config->protocol == Protocol::wb) {
+        completed(nullptr, correctCmdCnt == 0 && lineCnt > 0);
         return;
     }
     
     setState(PlayerState::stopping);
     
-    config.protocol = Protocol::wb;
+    setProtocol(Protocol::wb);
     setupEngine();
     
     usedCmdSet.clear();
     correctCmdCnt = 0;
+    lineCnt = 0;
     tick_idle = 0;
     tick_test = tick_test_period;
     tryNum = 3;
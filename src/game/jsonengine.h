@@ -55,6 +55,19 @@ namespace banksia {
         bool isFinished() const {
             return jsonstate == JsonEngineState::done;
         }
+        
+        // stop probing, the callback gets no config
+        void cancel();
+        
+        // the probe failed for sure (the process exited or it replied without the protocol),
+        // not because the engine was slow or the probe was cancelled
+        bool isRejected() const {
+            return rejected;
+        }
+        
+        const Handshake& getEngineHandshake() const {
+            return engine->getHandshake();
+        }
     private:
         const std::unordered_map<std::string, int>& getEngineCmdMap() const override;
         void parseLine(int, const std::string&, const std::string&) override;
@@ -66,14 +79,20 @@ namespace banksia {
         void prepareToDeattach() override {}
         bool stop() override { return true; }
         bool isAttached() const override;
+        void finished() override;
 
 //        void log(const std::string& line, LogType logType) const override;
 
     private:
-        void completed(Config* config);
+        void completed(Config* config, bool rejected = false);
+        void succeeded();
         void setupEngine();
+        void setProtocol(Protocol protocol);
         
-        JsonEngineState jsonstate = JsonEngineState::none;
+        // could be completed from the timer, the reading or the process threads
+        std::atomic<JsonEngineState> jsonstate { JsonEngineState::none };
+        std::atomic<bool> rejected { false };
+        std::atomic<int> lineCnt { 0 }; // all lines from the engine, including unknown ones
         Protocol originalProtocol;
 
         std::function<void(Config* config)> taskComplete = nullptr;
@@ -26,8 +26,19 @@
 #include <assert.h>
 #include <fstream>
 #include <sstream>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "jsonmaker.h"
+#include "handshakecache.h"
 
 using namespace banksia;
 
@@ -61,6 +72,12 @@ static const std::string jsonTourString =
 "    },\n"
 "    \"logs\" :\n"
 "    {\n"
+"        \"archive\" :\n"
+"        {\n"
+"            \"guide\" : \"games in a compressed binary file (moves, scores, depths, elapses), convert it into PGN by: banksia -archive path\",\n"
+"            \"mode\" : false,\n"
+"            \"path\" : \"games.bka\"\n"
+"        },\n"
 "        \"engine\" :\n"
 "        {\n"
 "            \"game title surfix\" : true,\n"
@@ -84,6 +101,12 @@ static const std::string jsonTourString =
 "        {\n"
 "            \"mode\" : true,\n"
 "            \"path\" : \"logresult.txt\"\n"
+"        },\n"
+"        \"training data\" :\n"
+"        {\n"
+"            \"guide\" : \"positions of games with scores of engines (binary records of 40 bytes for training such as NNUE, read README)\",\n"
+"            \"mode\" : false,\n"
+"            \"path\" : \"trainingdata.bin\"\n"
 "        }\n"
 "    },\n"
 "    \"openings\" :\n"
@@ -130,6 +153,30 @@ static const std::string jsonTourString =
 "        \"tablebase max pieces\" : 7,\n"
 "        \"tablebase\" : true\n"
 "    },\n"
+"    \"sprt\" :\n"
+"    {\n"
+"        \"mode\" : false,\n"
+"        \"guide\" : \"sequential probability ratio test, stop the tournament when a bound is crossed; player: the tested one (empty: the only inclusive player or the first in players); elo0, elo1: hypotheses H0, H1; alpha, beta: error rates; pentanomial model when games per pair >= 2 and swap pair sides\",\n"
+"        \"player\" : \"\",\n"
+"        \"elo0\" : 0,\n"
+"        \"elo1\" : 5,\n"
+"        \"alpha\" : 0.05,\n"
+"        \"beta\" : 0.05\n"
+"    },\n"
+"    \"opening stats\" :\n"
+"    {\n"
+"        \"mode\" : false,\n"
+"        \"guide\" : \"wins, draws, losses per opening (by its last position), written into the file path; drop same pairs: stop using openings when all their pairs (two games with swapped sides) have the same decisive results for white (draws are not the same), after min pairs\",\n"
+"        \"path\" : \"openings.json\",\n"
+"        \"drop same pairs\" : false,\n"
+"        \"min pairs\" : 2\n"
+"    },\n"
+"    \"metrics\" :\n"
+"    {\n"
+"        \"mode\" : false,\n"
+"        \"guide\" : \"a local HTTP endpoint (http://127.0.0.1:port/metrics) in Prometheus text format: games/min, moves/sec, active games, engine start latency, engine nps, time forfeits, crashes, log queue depth, tick lag\",\n"
+"        \"port\" : 9100\n"
+"    },\n"
 "    \"override options\" :\n"
 "    {\n"
 "        \"base\" :\n"
@@ -206,6 +253,8 @@ void JsonMaker::tickWork()
         return;
     }
     
+    std::lock_guard<std::recursive_mutex> dolock(workMutex);
+    
     tick_idle++;
     
     if (tick_idle > tick_idle_max) {
@@ -213,8 +262,10 @@ void JsonMaker::tickWork()
         exit(1);
     }
     
+    // a copy since callbacks of completed probes may start new ones
+    auto engineVec = workingEngineVec;
     std::vector<JsonEngine*> removingEngineVec;
-    for(auto && e : workingEngineVec) {
+    for(auto && e : engineVec) {
         e->tickWork();
         if (e->isFinished() && e->isSafeToDelete()) {
             removingEngineVec.push_back(e);
@@ -231,41 +282,122 @@ void JsonMaker::tickWork()
         delete e;
     }
     
-    // kick start one each time, not all at one
-    if (!configVec.empty() && workingEngineVec.size() < concurrency) {
+    kickStartProbes();
+    
+    // Completed
+    if (configVec.empty() && workingEngineVec.empty()) {
+        completed();
+    }
+}
+
+// Fill all free slots (bounded by the concurrency). It is called by the timer and
+// whenever a probe is completed, thus a new one doesn't wait for the next tick
+void JsonMaker::kickStartProbes()
+{
+    std::lock_guard<std::recursive_mutex> dolock(workMutex);
+    
+    auto workingCnt = std::count_if(workingEngineVec.begin(), workingEngineVec.end(), [](const JsonEngine* e) {
+        return !e->isFinished();
+    });
+    
+    while (!configVec.empty() && workingCnt < concurrency) {
         tick_idle = 0;
         auto config = configVec.back();
         configVec.pop_back();
         
+        // detected already by the probe of the other protocol
+        if (detectedSet.find(config.command) != detectedSet.end()) {
+            probeCntMap[config.command]--;
+            continue;
+        }
+        
         auto jsonEngine = new JsonEngine(config);
         workingEngineVec.push_back(jsonEngine);
+        workingCnt++;
         
         jsonEngine->kickStart([=](Config* rConfig) {
-            tick_idle = 0;
+            probeCompleted(jsonEngine, rConfig);
+        });
+    }
+}
+
+// it may be called from the threads of engines
+void JsonMaker::probeCompleted(JsonEngine* jsonEngine, Config* config)
+{
+    std::lock_guard<std::recursive_mutex> dolock(workMutex);
+    tick_idle = 0;
+    
+    auto command = jsonEngine->config->command;
+    auto cnt = --probeCntMap[command];
+    
+    if (detectedSet.find(command) == detectedSet.end()) {
+        if (config) {
+            // the engine may be detected without completing the handshake
+            auto handshake = jsonEngine->getEngineHandshake();
+            handshake.protocol = config->protocol;
+            handshake.idName = config->idName;
+            handshake.variantSet = config->variantSet;
             
-            if (rConfig) {
-                if (rConfig->name.empty() || rConfig->name.find("<<<") != std::string::npos) {
-                    if (!rConfig->idName.empty()) {
-                        rConfig->name = rConfig->idName;
-                    } else {
-                        rConfig->name = getFileName(rConfig->command);
-                    }
-                }
-                
-                std::cout << "OK, an engine detected: " << rConfig->name << ", " << nameFromProtocol(rConfig->protocol) << std::endl;
-                goodConfigVec.push_back(*rConfig);
+            // as the sequential order (UCI first), engines of both protocols are UCI ones
+            if (config->protocol == Protocol::wb && cnt > 0) {
+                wbProbeMap[command] = std::make_pair(*config, handshake);
             } else {
-                std::cout << "  not an engine: " << config.command << std::endl;
+                probeDetected(*config, handshake);
             }
-        });
+        } else {
+            if (!jsonEngine->isRejected()) {
+                uncertainSet.insert(command);
+            }
+            
+            if (cnt <= 0) {
+                auto it = wbProbeMap.find(command);
+                if (it != wbProbeMap.end()) {
+                    probeDetected(it->second.first, it->second.second);
+                } else if (uncertainSet.find(command) != uncertainSet.end()) {
+                    // a slow engine may reply next time, don't remember it
+                    std::cout << "  no reply: " << command << std::endl;
+                } else {
+                    std::cout << "  not an engine: " << command << std::endl;
+                    handshakeCache.update(command, Handshake());
+                }
+            }
+        }
     }
     
-    // Completed
-    if (configVec.empty() && workingEngineVec.empty()) {
-        completed();
+    kickStartProbes();
+}
+
+void JsonMaker::probeDetected(Config config, const Handshake& handshake)
+{
+    auto command = config.command;
+    detectedSet.insert(command);
+    wbProbeMap.erase(command);
+    handshakeCache.update(command, handshake);
+    engineDetected(config);
+    
+    // the probe of the other protocol is not needed anymore
+    auto engineVec = workingEngineVec;
+    for(auto && e : engineVec) {
+        if (e->config->command == command && !e->isFinished()) {
+            e->cancel();
+        }
     }
 }
 
+void JsonMaker::engineDetected(Config& config)
+{
+    if (config.name.empty() || config.name.find("<<<") != std::string::npos) {
+        if (!config.idName.empty()) {
+            config.name = config.idName;
+        } else {
+            config.name = getFileName(config.command);
+        }
+    }
+    
+    std::cout << "OK, an engine detected: " << config.name << ", " << nameFromProtocol(config.protocol) << std::endl;
+    goodConfigVec.push_back(config);
+}
+
 //auto jsonPath = "/Users/nguyenpham/workspace/BanksiaMatch/test.json";
 
 void JsonMaker::completed()
@@ -288,6 +420,7 @@ void JsonMaker::completed()
     
     ConfigMng::instance->setJsonPath(jsonEngineConfigPath);
     ConfigMng::instance->saveToJsonFile();
+    handshakeCache.save();
     
     // update tour json
     {
@@ -301,6 +434,8 @@ void JsonMaker::completed()
 		auto logs = sample["logs"];
 		logs["engine"]["path"] = curPath + logs["engine"]["path"].asString();
 		logs["pgn"]["path"] = curPath + logs["pgn"]["path"].asString();
+		logs["archive"]["path"] = curPath + logs["archive"]["path"].asString();
+		logs["training data"]["path"] = curPath + logs["training data"]["path"].asString();
 		logs["result"]["path"] = curPath + logs["result"]["path"].asString();
 		sample["logs"] = logs;
 
@@ -385,11 +520,11 @@ void JsonMaker::build(const std::string& mainJsonPath, const std::string& mainEn
     ConfigMng::instance->loadFromJsonFile(jsonEngineConfigPath, false);
     
     for(auto && config : ConfigMng::instance->configList()) {
-        if (config.command.empty() || pathSet.find(config.command) != pathSet.end()) {
+        if (config->command.empty() || pathSet.find(config->command) != pathSet.end()) {
             continue;
         }
-        configVec.push_back(config);
-        pathSet.insert(config.command);
+        configVec.push_back(*config);
+        pathSet.insert(config->command);
     }
     
     if (!motherEngineFolder.empty()) {
@@ -407,6 +542,42 @@ void JsonMaker::build(const std::string& mainJsonPath, const std::string& mainEn
     
     std::cout << " executable file number: " << configVec.size() << ", concurrency: " << concurrency << std::endl << std::endl;
     
+    // binaries unchanged since their last checks don't need to run again
+    handshakeCache.load();
+    std::vector<Config> probeVec;
+    for(auto && config : configVec) {
+        Handshake handshake;
+        if (handshakeCache.find(config.command, handshake)) {
+            if (!handshake.isEngine()) {
+                std::cout << "  not an engine: " << config.command << std::endl;
+                continue;
+            }
+            
+            config.protocol = handshake.protocol;
+            config.idName = handshake.idName;
+            config.variantSet = handshake.variantSet;
+            for(auto && option : handshake.optionList) {
+                config.updateOption(option);
+            }
+            engineDetected(config);
+            continue;
+        }
+        
+        // unknown protocol: probe UCI and Winboard at the same time, the first reply wins
+        if (config.protocol == Protocol::none) {
+            auto c = config;
+            c.protocol = Protocol::wb;
+            probeVec.push_back(c);
+            c.protocol = Protocol::uci;
+            probeVec.push_back(c);
+            probeCntMap[config.command] = 2;
+        } else {
+            probeVec.push_back(config);
+            probeCntMap[config.command] = 1;
+        }
+    }
+    configVec = probeVec;
+    
     state = JsonMakerState::working;
     
     mainTimerId = timer.add(std::chrono::milliseconds(500), [=](CppTime::timer_id) { tick(); }, std::chrono::milliseconds(500));
@@ -419,16 +590,32 @@ bool JsonMaker::isRunable(const std::string& path)
     return isExecutable(path);
 }
 
+std::vector<std::string> JsonMaker::listExcecutablePaths(const std::string& dirname)
+{
+    auto fullpath = getFullPath(dirname.c_str());
+    auto vec = listdir(fullpath);
+    
+    std::vector<std::string> v;
+    for(auto && path : vec) {
+        if (isRunable(path)) {
+            v.push_back(path);
+        }
+    }
+    return v;
+}
+
 #else
 
 static const std::set<std::string>extSet {
     "txt", "pdf", "ini", "db", "mak", "def", "prj", "sln", "dat",
     "htm", "html", "xml", "json", "doc", "docx", "rtf", "md", "md5", "log", "bk",
     "jpg", "jpeg", "gif", "png", "bmp", "ico", "rc", "rb",
-    "zip", "7z", "rar", "arj", "gz", "tgz",
-    "bok", "pgn", "lrn", "epd",
-    "rtbw", "rtbz", "cp4", "atbw", "atbz", "emd", "cmp",
-    "h", "hpp", "c", "cpp", "cc", "java", "bas", "o", "obj",
+    "zip", "7z", "rar", "arj", "gz", "tgz", "xz", "bz2", "zst",
+    "bok", "pgn", "lrn", "epd", "abk", "ctg", "ctb", "cto", "obk",  // books
+    "rtbw", "rtbz", "cp4", "atbw", "atbz", "emd", "cmp", "gtb",     // tablebases
+    "nnue", "nn", "pb", "onnx", "weights",                          // networks
+    "h", "hpp", "c", "cpp", "cc", "java", "class", "jar", "bas", "o", "obj",
+    "so", "dylib", "a",
     "bat", "bin", "exe", "dll"
 };
 
@@ -436,39 +623,162 @@ static const std::set<std::string>exclusiveFileNameSet {
     "makefile", "readme", "license",
 };
 
-bool JsonMaker::isRunable(const std::string& path)
+static bool isSkippedName(const std::string& fileName)
 {
-    if (!isExecutable(path)) return false;
+    auto name = fileName;
+    toLower(name);
     
-    auto p = path.rfind(".");
-    if (p != std::string::npos && path.size() - p <= 5) {
-        auto extString = path.substr(p + 1);
-        toLower(extString);
+    auto p = name.rfind(".");
+    if (p != std::string::npos && name.size() - p <= 8) {
+        auto extString = name.substr(p + 1);
         if (extSet.find(extString) != extSet.end()) {
-            return false;
+            return true;
         }
     }
     
-    auto fileName = getFileName(path);
-    toLower(fileName);
-    return exclusiveFileNameSet.find(fileName) == exclusiveFileNameSet.end();
+    return exclusiveFileNameSet.find(name) != exclusiveFileNameSet.end()
+        || name.find(".so.") != std::string::npos; // versioned libraries
 }
 
-#endif
+// the first bytes of binaries (ELF, Mach-O) or scripts (#!)
+static bool hasExecutableMagic(int fd)
+{
+    unsigned char buf[4];
+    auto n = read(fd, buf, sizeof(buf));
+    if (n >= 2 && buf[0] == '#' && buf[1] == '!') {
+        return true;
+    }
+    if (n < 4) {
+        return false;
+    }
+    
+    u32 magic = u32(buf[0]) << 24 | u32(buf[1]) << 16 | u32(buf[2]) << 8 | buf[3];
+    return magic == 0x7f454c46                              // ELF
+        || magic == 0xfeedface || magic == 0xcefaedfe       // Mach-O 32
+        || magic == 0xfeedfacf || magic == 0xcffaedfe       // Mach-O 64
+        || magic == 0xcafebabe;                             // Mach-O universal
+}
 
-std::vector<std::string> JsonMaker::listExcecutablePaths(const std::string& dirname)
+// executable bit and magic, the name is checked already
+static bool isRunableAt(int dirFd, const char* name)
 {
+    if (faccessat(dirFd, name, X_OK, 0) != 0) {
+        return false;
+    }
     
-    auto fullpath = getFullPath(dirname.c_str());
-    auto vec = listdir(fullpath);
+    auto fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    auto r = hasExecutableMagic(fd);
+    close(fd);
+    return r;
+}
+
+bool JsonMaker::isRunable(const std::string& path)
+{
+    return !isSkippedName(getFileName(path)) && isRunableAt(AT_FDCWD, path.c_str());
+}
+
+// Entries of a folder: types are from readdir, stat is called for unknown ones
+// and symbolic links only. Symbolic links of folders are not followed
+static void scanFolder(const std::string& folder, std::vector<std::string>& subFolders, std::vector<std::string>& paths)
+{
+    auto dirFd = open(folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return;
+    }
+    auto dir = fdopendir(dirFd);
+    if (dir == nullptr) {
+        close(dirFd);
+        return;
+    }
     
-    std::vector<std::string> v;
-    for(auto && path : vec) {
-        if (isRunable(path)) {
-            v.push_back(path);
+    auto prefix = folder;
+    if (prefix.empty() || prefix.back() != '/') {
+        prefix += "/";
+    }
+    
+    while (auto entry = readdir(dir)) {
+        auto name = entry->d_name;
+        if (name[0] == '.') { // ., .. and hidden ones
+            continue;
+        }
+        
+        auto type = entry->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat st;
+            if (fstatat(dirFd, name, &st, 0) != 0) {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                if (type == DT_LNK) {
+                    continue;
+                }
+                type = DT_DIR;
+            } else {
+                type = S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+        }
+        
+        if (type == DT_DIR) {
+            subFolders.push_back(prefix + name);
+        } else if (type == DT_REG && !isSkippedName(name) && isRunableAt(dirFd, name)) {
+            paths.push_back(prefix + name);
         }
     }
-    return v;
+    
+    closedir(dir); // closes dirFd too
 }
 
+// Folders are scanned by a few threads since most of the time is waiting for
+// the file system (it may be a network one)
+std::vector<std::string> JsonMaker::listExcecutablePaths(const std::string& dirname)
+{
+    std::deque<std::string> folderQueue { getFullPath(dirname.c_str()) };
+    std::vector<std::string> result;
+    std::mutex mutex;
+    std::condition_variable cv;
+    int busyCnt = 0;
+    
+    auto worker = [&]() {
+        for(;;) {
+            std::string folder;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !folderQueue.empty() || busyCnt == 0; });
+                if (folderQueue.empty()) {
+                    return;
+                }
+                folder = folderQueue.front();
+                folderQueue.pop_front();
+                busyCnt++;
+            }
+            
+            std::vector<std::string> subFolders, paths;
+            scanFolder(folder, subFolders, paths);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                folderQueue.insert(folderQueue.end(), subFolders.begin(), subFolders.end());
+                result.insert(result.end(), paths.begin(), paths.end());
+                busyCnt--;
+            }
+            cv.notify_all();
+        }
+    };
+    
+    auto threadCnt = std::min(16, std::max(4, getNumberOfCores()));
+    std::vector<std::thread> threads;
+    for(int i = 0; i < threadCnt; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    for(auto && t : threads) {
+        t.join();
+    }
+    
+    std::sort(result.begin(), result.end());
+    return result;
+}
 
+#endif
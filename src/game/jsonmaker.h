@@ -27,6 +27,9 @@
 #define jsonmaker_h
 
 #include <stdio.h>
+#include <map>
+#include <set>
+#include <mutex>
 
 #include "tourmng.h"
 #include "jsonengine.h"
@@ -60,6 +63,10 @@ namespace banksia {
     private:
         virtual void tickWork() override;
         void completed();
+        void engineDetected(Config& config);
+        void kickStartProbes();
+        void probeCompleted(JsonEngine* jsonEngine, Config* config);
+        void probeDetected(Config config, const Handshake& handshake);
         
     private:
         JsonMakerState state = JsonMakerState::begin;
@@ -70,6 +77,13 @@ namespace banksia {
         
         std::vector<JsonEngine*> workingEngineVec;
         std::vector<Config> goodConfigVec;
+        
+        // number of running probes of each binary, binaries detected as engines
+        std::map<std::string, int> probeCntMap;
+        std::set<std::string> detectedSet;
+        std::set<std::string> uncertainSet; // binaries with probes failed by time out or cancelled
+        std::map<std::string, std::pair<Config, Handshake>> wbProbeMap; // waiting for UCI probes
+        std::recursive_mutex workMutex;
 
         CppTime::Timer timer;
         CppTime::timer_id mainTimerId;
@@ -0,0 +1,520 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <cstdint>
+
+#include "jsonreader.h"
+
+using namespace banksia;
+
+static const size_t jsonReaderBufferSize = 64 * 1024;
+
+JsonReader::~JsonReader()
+{
+    close();
+}
+
+bool JsonReader::open(const std::string& path)
+{
+    close();
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    buffer.resize(jsonReaderBufferSize);
+    return true;
+}
+
+void JsonReader::close()
+{
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    pos = size = 0;
+    line = 1;
+    firstItemStack.clear();
+    errorString.clear();
+}
+
+int JsonReader::peekChar()
+{
+    if (pos >= size) {
+        if (!file) {
+            return EOF;
+        }
+        size = fread(buffer.data(), 1, buffer.size(), file);
+        pos = 0;
+        if (size == 0) {
+            return EOF;
+        }
+    }
+    return static_cast<unsigned char>(buffer[pos]);
+}
+
+int JsonReader::getChar()
+{
+    auto ch = peekChar();
+    if (ch != EOF) {
+        pos++;
+        if (ch == '\n') {
+            line++;
+        }
+    }
+    return ch;
+}
+
+bool JsonReader::setError(const std::string& msg)
+{
+    if (errorString.empty()) {
+        errorString = "line " + std::to_string(line) + ": " + msg;
+    }
+    return false;
+}
+
+// white spaces and comments (// and /* */)
+bool JsonReader::skipSpaces()
+{
+    while (true) {
+        auto ch = peekChar();
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+            getChar();
+            continue;
+        }
+        if (ch != '/') {
+            return true;
+        }
+        
+        getChar();
+        ch = getChar();
+        if (ch == '/') {
+            while ((ch = getChar()) != EOF && ch != '\n') {}
+        } else if (ch == '*') {
+            auto last = 0;
+            while ((ch = getChar()) != EOF && !(last == '*' && ch == '/')) {
+                last = ch;
+            }
+            if (ch == EOF) {
+                return setError("unterminated comment");
+            }
+        } else {
+            return setError("unexpected character '/'");
+        }
+    }
+}
+
+bool JsonReader::expect(char ch)
+{
+    if (!skipSpaces()) {
+        return false;
+    }
+    if (peekChar() != ch) {
+        return setError(std::string("expected '") + ch + "'");
+    }
+    getChar();
+    return true;
+}
+
+JsonReader::ValueType JsonReader::peek()
+{
+    if (hasError() || !skipSpaces()) {
+        return ValueType::none;
+    }
+    
+    switch (peekChar()) {
+        case '{':
+            return ValueType::object;
+        case '[':
+            return ValueType::array;
+        case '"':
+            return ValueType::string;
+        case 't':
+        case 'f':
+            return ValueType::boolean;
+        case 'n':
+            return ValueType::null;
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return ValueType::number;
+        default:
+            return ValueType::none;
+    }
+}
+
+bool JsonReader::beginObject()
+{
+    if (hasError() || !expect('{')) {
+        return false;
+    }
+    firstItemStack.push_back(true);
+    return true;
+}
+
+bool JsonReader::beginArray()
+{
+    if (hasError() || !expect('[')) {
+        return false;
+    }
+    firstItemStack.push_back(true);
+    return true;
+}
+
+// Return false when the closing character is read (or on errors), items after the first one
+// need a comma, a comma before the closing character is ignored
+bool JsonReader::nextItem(char closeCh)
+{
+    if (hasError() || firstItemStack.empty() || !skipSpaces()) {
+        return false;
+    }
+    
+    if (!firstItemStack.back()) {
+        if (peekChar() == ',') {
+            getChar();
+            if (!skipSpaces()) {
+                return false;
+            }
+        } else if (peekChar() != closeCh) {
+            return setError(std::string("expected ',' or '") + closeCh + "'");
+        }
+    }
+    
+    if (peekChar() == closeCh) {
+        getChar();
+        firstItemStack.pop_back();
+        return false;
+    }
+    
+    firstItemStack.back() = false;
+    return true;
+}
+
+bool JsonReader::nextMember(std::string& key)
+{
+    if (!nextItem('}')) {
+        return false;
+    }
+    return readString(key) && expect(':');
+}
+
+bool JsonReader::nextElement()
+{
+    return nextItem(']');
+}
+
+static void appendUtf8(std::string& str, u32 code)
+{
+    if (code < 0x80) {
+        str += static_cast<char>(code);
+    } else if (code < 0x800) {
+        str += static_cast<char>(0xc0 | code >> 6);
+        str += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        str += static_cast<char>(0xe0 | code >> 12);
+        str += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        str += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        str += static_cast<char>(0xf0 | code >> 18);
+        str += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+        str += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        str += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+bool JsonReader::readString(std::string& str)
+{
+    str.clear();
+    if (hasError() || !expect('"')) {
+        return false;
+    }
+    
+    auto readHex4 = [&](u32& code) {
+        code = 0;
+        for(int i = 0; i < 4; i++) {
+            auto ch = getChar();
+            code <<= 4;
+            if (ch >= '0' && ch <= '9') code |= ch - '0';
+            else if (ch >= 'a' && ch <= 'f') code |= ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F') code |= ch - 'A' + 10;
+            else return setError("bad unicode escape");
+        }
+        return true;
+    };
+    
+    while (true) {
+        auto ch = getChar();
+        if (ch == EOF) {
+            return setError("unterminated string");
+        }
+        if (ch == '"') {
+            return true;
+        }
+        if (ch != '\\') {
+            str += static_cast<char>(ch);
+            continue;
+        }
+        
+        ch = getChar();
+        switch (ch) {
+            case '"': case '\\': case '/':
+                str += static_cast<char>(ch);
+                break;
+            case 'b': str += '\b'; break;
+            case 'f': str += '\f'; break;
+            case 'n': str += '\n'; break;
+            case 'r': str += '\r'; break;
+            case 't': str += '\t'; break;
+            case 'u':
+            {
+                u32 code;
+                if (!readHex4(code)) {
+                    return false;
+                }
+                // surrogate pairs
+                if (code >= 0xd800 && code <= 0xdbff) {
+                    u32 low;
+                    if (getChar() != '\\' || getChar() != 'u' || !readHex4(low) || low < 0xdc00 || low > 0xdfff) {
+                        return setError("bad unicode surrogate pair");
+                    }
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(str, code);
+                break;
+            }
+            default:
+                return setError("bad escape character");
+        }
+    }
+}
+
+bool JsonReader::readNumberString(std::string& str)
+{
+    str.clear();
+    if (peek() != ValueType::number) {
+        return setError("expected a number");
+    }
+    
+    while (true) {
+        auto ch = peekChar();
+        if ((ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E') {
+            str += static_cast<char>(getChar());
+        } else {
+            return true;
+        }
+    }
+}
+
+bool JsonReader::readNumber(double& value)
+{
+    std::string str;
+    if (!readNumberString(str)) {
+        return false;
+    }
+    char* end;
+    value = strtod(str.c_str(), &end);
+    return *end == 0 || setError("bad number " + str);
+}
+
+bool JsonReader::readInt64(i64& value)
+{
+    std::string str;
+    if (!readNumberString(str)) {
+        return false;
+    }
+    
+    char* end;
+    value = strtoll(str.c_str(), &end, 10);
+    if (*end != 0) { // fractions and exponents
+        value = static_cast<i64>(strtod(str.c_str(), &end));
+        if (*end != 0) {
+            return setError("bad number " + str);
+        }
+    }
+    return true;
+}
+
+bool JsonReader::readInt(int& value)
+{
+    i64 k;
+    if (!readInt64(k)) {
+        return false;
+    }
+    value = static_cast<int>(k);
+    return true;
+}
+
+bool JsonReader::readLiteral(const char* literal)
+{
+    for(auto p = literal; *p; p++) {
+        if (getChar() != *p) {
+            return setError(std::string("expected ") + literal);
+        }
+    }
+    return true;
+}
+
+bool JsonReader::readBool(bool& value)
+{
+    if (peek() != ValueType::boolean) {
+        return setError("expected a boolean");
+    }
+    value = peekChar() == 't';
+    return readLiteral(value ? "true" : "false");
+}
+
+bool JsonReader::readValue(Json::Value& value)
+{
+    switch (peek()) {
+        case ValueType::object:
+        {
+            value = Json::Value(Json::objectValue);
+            if (!beginObject()) {
+                return false;
+            }
+            std::string key;
+            while (nextMember(key)) {
+                if (!readValue(value[key])) {
+                    return false;
+                }
+            }
+            return !hasError();
+        }
+        case ValueType::array:
+        {
+            value = Json::Value(Json::arrayValue);
+            if (!beginArray()) {
+                return false;
+            }
+            while (nextElement()) {
+                if (!readValue(value.append(Json::Value()))) {
+                    return false;
+                }
+            }
+            return !hasError();
+        }
+        case ValueType::string:
+        {
+            std::string str;
+            if (!readString(str)) {
+                return false;
+            }
+            value = str;
+            return true;
+        }
+        case ValueType::number:
+        {
+            std::string str;
+            if (!readNumberString(str)) {
+                return false;
+            }
+            // integers are typed as jsoncpp does: large positive ones are unsigned
+            char* end;
+            if (str.find_first_of(".eE") == std::string::npos) {
+                auto k = strtoll(str.c_str(), &end, 10);
+                if (*end == 0) {
+                    if (k < 0 || k <= INT32_MAX) {
+                        value = Json::Value(static_cast<Json::Int64>(k));
+                    } else {
+                        value = Json::Value(static_cast<Json::UInt64>(k));
+                    }
+                    return true;
+                }
+            }
+            auto d = strtod(str.c_str(), &end);
+            if (*end != 0) {
+                return setError("bad number " + str);
+            }
+            value = d;
+            return true;
+        }
+        case ValueType::boolean:
+        {
+            bool b;
+            if (!readBool(b)) {
+                return false;
+            }
+            value = b;
+            return true;
+        }
+        case ValueType::null:
+            value = Json::Value();
+            return readLiteral("null");
+            
+        default:
+            return setError(peekChar() == EOF ? "unexpected end of file" : "unexpected character");
+    }
+}
+
+bool JsonReader::skipValue()
+{
+    switch (peek()) {
+        case ValueType::object:
+        {
+            if (!beginObject()) {
+                return false;
+            }
+            std::string key;
+            while (nextMember(key)) {
+                if (!skipValue()) {
+                    return false;
+                }
+            }
+            return !hasError();
+        }
+        case ValueType::array:
+        {
+            if (!beginArray()) {
+                return false;
+            }
+            while (nextElement()) {
+                if (!skipValue()) {
+                    return false;
+                }
+            }
+            return !hasError();
+        }
+        case ValueType::string:
+        {
+            std::string str;
+            return readString(str);
+        }
+        case ValueType::number:
+        {
+            std::string str;
+            return readNumberString(str);
+        }
+        case ValueType::boolean:
+        {
+            bool b;
+            return readBool(b);
+        }
+        case ValueType::null:
+            return readLiteral("null");
+            
+        default:
+            return setError(peekChar() == EOF ? "unexpected end of file" : "unexpected character");
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef jsonreader_h
+#define jsonreader_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // A pull parser reading a JSON file by chunks. Callers walk the document and take values
+    // straight into their own structures, only the parts they ask for (readValue) become
+    // Json::Value. Comments are accepted as jsoncpp does, trailing commas too
+    class JsonReader
+    {
+    public:
+        enum class ValueType {
+            object, array, string, number, boolean, null, none
+        };
+        
+        ~JsonReader();
+        
+        bool open(const std::string& path);
+        void close();
+        
+        // type of the next value without reading it, none at the end or on errors
+        ValueType peek();
+        
+        // loops: beginObject(); while (nextMember(key)) { read or skip the value }
+        bool beginObject();
+        bool nextMember(std::string& key);
+        bool beginArray();
+        bool nextElement();
+        
+        bool readString(std::string& str);
+        bool readNumber(double& value);
+        bool readInt(int& value);
+        bool readInt64(i64& value);
+        bool readBool(bool& value);
+        bool readValue(Json::Value& value);
+        bool skipValue();
+        
+        bool hasError() const {
+            return !errorString.empty();
+        }
+        const std::string& getError() const {
+            return errorString;
+        }
+        
+    private:
+        int peekChar();
+        int getChar();
+        bool skipSpaces();
+        bool expect(char ch);
+        bool nextItem(char closeCh);
+        bool readNumberString(std::string& str);
+        bool readLiteral(const char* literal);
+        bool setError(const std::string& msg);
+        
+    private:
+        FILE* file = nullptr;
+        std::vector<char> buffer;
+        size_t pos = 0, size = 0;
+        int line = 1;
+        
+        // of opening objects and arrays: true until their first items are read
+        std::vector<bool> firstItemStack;
+        std::string errorString;
+    };
+    
+} // namespace banksia
+
+#endif /* jsonreader_h */
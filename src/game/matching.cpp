@@ -0,0 +1,384 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+#include "matching.h"
+
+using namespace banksia;
+
+WeightedMatching::WeightedMatching(int vertexCnt)
+{
+    n = std::max(0, vertexCnt);
+    nx = n;
+    m = n * 2 + 1;
+    
+    g.resize(m * m);
+    for(int u = 0; u < m; u++) {
+        for(int v = 0; v < m; v++) {
+            auto& e = edge(u, v);
+            e.u = u; e.v = v;
+        }
+    }
+    
+    lab.resize(m, 0);
+    mate.resize(m, 0);
+    slack.resize(m, 0);
+    st.resize(m, 0);
+    pa.resize(m, 0);
+    S.resize(m, 0);
+    vis.resize(m, 0);
+    floFrom.resize(m * (n + 1), 0);
+    flo.resize(m);
+}
+
+bool WeightedMatching::isValid() const
+{
+    return n >= 0 && g.size() == m * m;
+}
+
+std::string WeightedMatching::toString() const
+{
+    return "vertices: " + std::to_string(n);
+}
+
+void WeightedMatching::setWeight(int u, int v, i64 w)
+{
+    assert(u >= 0 && u < n && v >= 0 && v < n && u != v);
+    w = std::max(i64(0), w);
+    edge(u + 1, v + 1).w = edge(v + 1, u + 1).w = w;
+}
+
+void WeightedMatching::updateSlack(int u, int x)
+{
+    if (!slack[x] || delta(edge(u, x)) < delta(edge(slack[x], x))) {
+        slack[x] = u;
+    }
+}
+
+void WeightedMatching::setSlack(int x)
+{
+    slack[x] = 0;
+    for(int u = 1; u <= n; ++u) {
+        if (edge(u, x).w > 0 && st[u] != x && S[st[u]] == 0) {
+            updateSlack(u, x);
+        }
+    }
+}
+
+void WeightedMatching::pushQueue(int x)
+{
+    if (x <= n) {
+        queue.push_back(x);
+        return;
+    }
+    for(size_t i = 0; i < flo[x].size(); i++) {
+        pushQueue(flo[x][i]);
+    }
+}
+
+void WeightedMatching::setSt(int x, int b)
+{
+    st[x] = b;
+    if (x > n) {
+        for(size_t i = 0; i < flo[x].size(); ++i) {
+            setSt(flo[x][i], b);
+        }
+    }
+}
+
+int WeightedMatching::getPr(int b, int xr)
+{
+    auto pr = int(std::find(flo[b].begin(), flo[b].end(), xr) - flo[b].begin());
+    if (pr & 1) {
+        std::reverse(flo[b].begin() + 1, flo[b].end());
+        return int(flo[b].size()) - pr;
+    }
+    return pr;
+}
+
+void WeightedMatching::setMatch(int u, int v)
+{
+    mate[u] = edge(u, v).v;
+    if (u <= n) {
+        return;
+    }
+    auto e = edge(u, v);
+    auto xr = floFrom[u * (n + 1) + e.u], pr = getPr(u, xr);
+    for(int i = 0; i < pr; ++i) {
+        setMatch(flo[u][i], flo[u][i ^ 1]);
+    }
+    setMatch(xr, v);
+    std::rotate(flo[u].begin(), flo[u].begin() + pr, flo[u].end());
+}
+
+void WeightedMatching::augment(int u, int v)
+{
+    for(;;) {
+        auto xnv = st[mate[u]];
+        setMatch(u, v);
+        if (!xnv) {
+            return;
+        }
+        setMatch(xnv, st[pa[xnv]]);
+        u = st[pa[xnv]]; v = xnv;
+    }
+}
+
+int WeightedMatching::getLca(int u, int v)
+{
+    for(++visStamp; u || v; std::swap(u, v)) {
+        if (u == 0) {
+            continue;
+        }
+        if (vis[u] == visStamp) {
+            return u;
+        }
+        vis[u] = visStamp;
+        u = st[mate[u]];
+        if (u) {
+            u = st[pa[u]];
+        }
+    }
+    return 0;
+}
+
+void WeightedMatching::addBlossom(int u, int lca, int v)
+{
+    auto b = n + 1;
+    while (b <= nx && st[b]) {
+        ++b;
+    }
+    if (b > nx) {
+        ++nx;
+    }
+    
+    lab[b] = 0; S[b] = 0;
+    mate[b] = mate[lca];
+    flo[b].clear();
+    flo[b].push_back(lca);
+    for(int x = u, y; x != lca; x = st[pa[y]]) {
+        flo[b].push_back(x);
+        flo[b].push_back(y = st[mate[x]]);
+        pushQueue(y);
+    }
+    std::reverse(flo[b].begin() + 1, flo[b].end());
+    for(int x = v, y; x != lca; x = st[pa[y]]) {
+        flo[b].push_back(x);
+        flo[b].push_back(y = st[mate[x]]);
+        pushQueue(y);
+    }
+    setSt(b, b);
+    
+    for(int x = 1; x <= nx; ++x) {
+        edge(b, x).w = edge(x, b).w = 0;
+    }
+    for(int x = 1; x <= n; ++x) {
+        floFrom[b * (n + 1) + x] = 0;
+    }
+    for(size_t i = 0; i < flo[b].size(); ++i) {
+        auto xs = flo[b][i];
+        for(int x = 1; x <= nx; ++x) {
+            if (edge(b, x).w == 0 || delta(edge(xs, x)) < delta(edge(b, x))) {
+                edge(b, x) = edge(xs, x);
+                edge(x, b) = edge(x, xs);
+            }
+        }
+        for(int x = 1; x <= n; ++x) {
+            if (floFrom[xs * (n + 1) + x]) {
+                floFrom[b * (n + 1) + x] = xs;
+            }
+        }
+    }
+    setSlack(b);
+}
+
+void WeightedMatching::expandBlossom(int b)
+{
+    for(size_t i = 0; i < flo[b].size(); ++i) {
+        setSt(flo[b][i], flo[b][i]);
+    }
+    auto xr = floFrom[b * (n + 1) + edge(b, pa[b]).u], pr = getPr(b, xr);
+    for(int i = 0; i < pr; i += 2) {
+        auto xs = flo[b][i], xns = flo[b][i + 1];
+        pa[xs] = edge(xns, xs).u;
+        S[xs] = 1; S[xns] = 0;
+        slack[xs] = 0;
+        setSlack(xns);
+        pushQueue(xns);
+    }
+    S[xr] = 1; pa[xr] = pa[b];
+    for(size_t i = pr + 1; i < flo[b].size(); ++i) {
+        auto xs = flo[b][i];
+        S[xs] = -1;
+        setSlack(xs);
+    }
+    st[b] = 0;
+}
+
+bool WeightedMatching::onFoundEdge(const Edge& e)
+{
+    auto u = st[e.u], v = st[e.v];
+    if (S[v] == -1) {
+        pa[v] = e.u; S[v] = 1;
+        auto nu = st[mate[v]];
+        slack[v] = slack[nu] = 0;
+        S[nu] = 0;
+        pushQueue(nu);
+    } else if (S[v] == 0) {
+        auto lca = getLca(u, v);
+        if (!lca) {
+            augment(u, v);
+            augment(v, u);
+            return true;
+        }
+        addBlossom(u, lca, v);
+    }
+    return false;
+}
+
+// one augmenting phase, false when no more augmenting path improves the weight
+bool WeightedMatching::matching()
+{
+    for(int x = 1; x <= nx; ++x) {
+        S[x] = -1; slack[x] = 0;
+    }
+    queue.clear(); queueHead = 0;
+    
+    for(int x = 1; x <= nx; ++x) {
+        if (st[x] == x && !mate[x]) {
+            pa[x] = 0; S[x] = 0;
+            pushQueue(x);
+        }
+    }
+    if (queue.empty()) {
+        return false;
+    }
+    
+    for(;;) {
+        while (queueHead < int(queue.size())) {
+            auto u = queue[queueHead++];
+            if (S[st[u]] == 1) {
+                continue;
+            }
+            for(int v = 1; v <= n; ++v) {
+                auto& e = edge(u, v);
+                if (e.w > 0 && st[u] != st[v]) {
+                    if (delta(e) == 0) {
+                        if (onFoundEdge(e)) {
+                            return true;
+                        }
+                    } else {
+                        updateSlack(u, st[v]);
+                    }
+                }
+            }
+        }
+        
+        auto d = std::numeric_limits<i64>::max();
+        for(int b = n + 1; b <= nx; ++b) {
+            if (st[b] == b && S[b] == 1) {
+                d = std::min(d, lab[b] / 2);
+            }
+        }
+        for(int x = 1; x <= nx; ++x) {
+            if (st[x] == x && slack[x]) {
+                if (S[x] == -1) {
+                    d = std::min(d, delta(edge(slack[x], x)));
+                } else if (S[x] == 0) {
+                    d = std::min(d, delta(edge(slack[x], x)) / 2);
+                }
+            }
+        }
+        
+        for(int u = 1; u <= n; ++u) {
+            if (S[st[u]] == 0) {
+                if (lab[u] <= d) {
+                    return false;
+                }
+                lab[u] -= d;
+            } else if (S[st[u]] == 1) {
+                lab[u] += d;
+            }
+        }
+        for(int b = n + 1; b <= nx; ++b) {
+            if (st[b] == b) {
+                if (S[st[b]] == 0) {
+                    lab[b] += d * 2;
+                } else if (S[st[b]] == 1) {
+                    lab[b] -= d * 2;
+                }
+            }
+        }
+        
+        queue.clear(); queueHead = 0;
+        for(int x = 1; x <= nx; ++x) {
+            if (st[x] == x && slack[x] && st[slack[x]] != x && delta(edge(slack[x], x)) == 0) {
+                if (onFoundEdge(edge(slack[x], x))) {
+                    return true;
+                }
+            }
+        }
+        for(int b = n + 1; b <= nx; ++b) {
+            if (st[b] == b && S[b] == 1 && lab[b] == 0) {
+                expandBlossom(b);
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<int> WeightedMatching::solve()
+{
+    nx = n;
+    i64 maxWeight = 0;
+    for(int u = 0; u < m; ++u) {
+        mate[u] = 0;
+        st[u] = u;
+        flo[u].clear();
+    }
+    for(int u = 1; u <= n; ++u) {
+        for(int v = 1; v <= n; ++v) {
+            floFrom[u * (n + 1) + v] = u == v ? u : 0;
+            maxWeight = std::max(maxWeight, edge(u, v).w);
+        }
+    }
+    for(int u = 1; u <= n; ++u) {
+        lab[u] = maxWeight;
+    }
+    
+    while (matching()) {
+    }
+    
+    std::vector<int> r(n, -1);
+    for(int u = 1; u <= n; ++u) {
+        if (mate[u]) {
+            r[u - 1] = mate[u] - 1;
+        }
+    }
+    return r;
+}
@@ -0,0 +1,85 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef matching_h
+#define matching_h
+
+#include <vector>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // Maximum weighted matching for general graphs (Edmonds' blossom algorithm, O(n^3))
+    class WeightedMatching : public Obj
+    {
+    public:
+        WeightedMatching(int vertexCnt);
+        virtual ~WeightedMatching() {}
+        
+        virtual const char* className() const override { return "WeightedMatching"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        // vertices are 0-based; only positive weights are edges
+        void setWeight(int u, int v, i64 w);
+        
+        // returns the mate of each vertex, -1 for unmatched ones
+        std::vector<int> solve();
+        
+    private:
+        struct Edge {
+            int u = 0, v = 0;
+            i64 w = 0;
+        };
+        
+        Edge& edge(int u, int v) { return g[u * m + v]; }
+        i64 delta(const Edge& e) const { return lab[e.u] + lab[e.v] - e.w * 2; }
+        
+        void updateSlack(int u, int x);
+        void setSlack(int x);
+        void pushQueue(int x);
+        void setSt(int x, int b);
+        int getPr(int b, int xr);
+        void setMatch(int u, int v);
+        void augment(int u, int v);
+        int getLca(int u, int v);
+        void addBlossom(int u, int lca, int v);
+        void expandBlossom(int b);
+        bool onFoundEdge(const Edge& e);
+        bool matching();
+        
+    private:
+        // 1-based vertices, blossoms are n + 1 ... nx
+        int n, nx, m, visStamp = 0, queueHead = 0;
+        std::vector<Edge> g;
+        std::vector<i64> lab;
+        std::vector<int> mate, slack, st, pa, S, vis, floFrom, queue;
+        std::vector<std::vector<int>> flo;
+    };
+    
+} // namespace banksia
+
+#endif /* matching_h */
@@ -0,0 +1,364 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#include <sstream>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET socket_xp;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_xp;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include "metrics.h"
+
+namespace banksia {
+    Metrics metrics;
+}
+
+using namespace banksia;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for(int i = 0; i < bucketCnt; i++) {
+        buckets[i] = 0;
+    }
+    cnt = maxMicros = 0;
+}
+
+void LatencyHistogram::add(double seconds)
+{
+    auto micros = std::max(i64(0), i64(seconds * 1e6));
+    auto idx = micros <= 1 ? 0 : std::min(bucketCnt - 1, int(std::log2(double(micros)) * 4) + 1);
+    buckets[idx]++;
+    cnt++;
+    
+    auto m = maxMicros.load();
+    while (micros > m && !maxMicros.compare_exchange_weak(m, micros)) {
+    }
+}
+
+double LatencyHistogram::max() const
+{
+    return double(maxMicros) / 1e6;
+}
+
+// the upper bound of the bucket having that percentile, not over the max
+double LatencyHistogram::percentile(double p) const
+{
+    i64 total = cnt;
+    if (total == 0) {
+        return 0;
+    }
+    
+    auto rank = std::max(i64(1), i64(std::ceil(p * total)));
+    i64 sum = 0;
+    for(int i = 0; i < bucketCnt; i++) {
+        sum += buckets[i];
+        if (sum >= rank) {
+            auto upper = std::pow(2.0, i / 4.0) / 1e6;
+            return std::min(upper, max());
+        }
+    }
+    return max();
+}
+
+std::string LatencyHistogram::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << std::fixed << std::setprecision(3)
+    << "n: " << count()
+    << ", p50: " << percentile(0.5) * 1000 << " ms"
+    << ", p99: " << percentile(0.99) * 1000 << " ms"
+    << ", max: " << max() * 1000 << " ms";
+    return stringStream.str();
+}
+
+/////////////////////////////////////////////
+Metrics* Metrics::instance = nullptr;
+
+Metrics::Metrics()
+{
+    assert(!instance);
+    instance = this;
+    serverRunning = false;
+    reset();
+}
+
+Metrics::~Metrics()
+{
+    stopServer();
+}
+
+void Metrics::reset()
+{
+    gameCnt = moveCnt = timeForfeitCnt = crashCnt = 0;
+    activeGameCnt = logQueueDepth = 0;
+    moveLatency.reset();
+    
+    std::lock_guard<std::mutex> dolock(dataMutex);
+    sampleList.clear();
+    ticked = false;
+    tickLag = tickLagMax = 0;
+    engineStartCnt = 0;
+    engineStartLatencySum = engineStartLatencyMax = 0;
+    engineNodesMap.clear();
+}
+
+void Metrics::tick(double period)
+{
+    auto now = std::chrono::steady_clock::now();
+    
+    std::lock_guard<std::mutex> dolock(dataMutex);
+    if (ticked) {
+        std::chrono::duration<double> elapsed = now - lastTickClock;
+        tickLag = std::max(0.0, elapsed.count() - period);
+        tickLagMax = std::max(tickLagMax, tickLag);
+    }
+    ticked = true;
+    lastTickClock = now;
+    
+    Sample sample;
+    sample.clock = now;
+    sample.gameCnt = gameCnt;
+    sample.moveCnt = moveCnt;
+    sampleList.push_back(sample);
+    
+    while (sampleList.size() > 2 && now - sampleList.front().clock > std::chrono::seconds(60)) {
+        sampleList.pop_front();
+    }
+}
+
+void Metrics::addEngineStart(double latency)
+{
+    std::lock_guard<std::mutex> dolock(dataMutex);
+    engineStartCnt++;
+    engineStartLatencySum += latency;
+    engineStartLatencyMax = std::max(engineStartLatencyMax, latency);
+}
+
+void Metrics::addEngineNodes(const std::string& name, i64 nodes, double elapsed)
+{
+    std::lock_guard<std::mutex> dolock(dataMutex);
+    auto& p = engineNodesMap[name];
+    p.first += nodes;
+    p.second += elapsed;
+}
+
+std::string Metrics::escapeLabel(const std::string& str)
+{
+    std::string s;
+    for(auto && ch : str) {
+        switch (ch) {
+            case '\\': s += "\\\\"; break;
+            case '"': s += "\\\""; break;
+            case '\n': s += "\\n"; break;
+            default: s += ch; break;
+        }
+    }
+    return s;
+}
+
+static void addMetric(std::ostringstream& stringStream, const char* name, const char* type, const char* help, double value)
+{
+    stringStream << "# HELP " << name << " " << help << "\n"
+    << "# TYPE " << name << " " << type << "\n"
+    << name << " " << value << "\n";
+}
+
+std::string Metrics::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << std::setprecision(12);
+    
+    std::lock_guard<std::mutex> dolock(dataMutex);
+    
+    double gamesPerMinute = 0, movesPerSecond = 0;
+    if (sampleList.size() >= 2) {
+        auto& first = sampleList.front(), & last = sampleList.back();
+        std::chrono::duration<double> elapsed = last.clock - first.clock;
+        if (elapsed.count() > 0) {
+            gamesPerMinute = (last.gameCnt - first.gameCnt) * 60.0 / elapsed.count();
+            movesPerSecond = (last.moveCnt - first.moveCnt) / elapsed.count();
+        }
+    }
+    
+    addMetric(stringStream, "banksia_games_completed_total", "counter", "Games completed.", double(gameCnt));
+    addMetric(stringStream, "banksia_games_per_minute", "gauge", "Games completed per minute, last minute.", gamesPerMinute);
+    addMetric(stringStream, "banksia_moves_total", "counter", "Moves made by engines.", double(moveCnt));
+    addMetric(stringStream, "banksia_moves_per_second", "gauge", "Moves made per second, last minute.", movesPerSecond);
+    addMetric(stringStream, "banksia_active_games", "gauge", "Games being played.", double(activeGameCnt));
+    addMetric(stringStream, "banksia_time_forfeits_total", "counter", "Games lost on time.", double(timeForfeitCnt));
+    addMetric(stringStream, "banksia_engine_crashes_total", "counter", "Games lost by engine crashes.", double(crashCnt));
+    addMetric(stringStream, "banksia_log_queue_depth", "gauge", "Log lines waiting to be written.", double(logQueueDepth));
+    addMetric(stringStream, "banksia_tick_lag_seconds", "gauge", "Delay of the last timer tick.", tickLag);
+    addMetric(stringStream, "banksia_tick_lag_max_seconds", "gauge", "Largest delay of timer ticks.", tickLagMax);
+    
+    stringStream << "# HELP banksia_engine_start_latency_seconds Time from starting an engine process to being ready.\n"
+    << "# TYPE banksia_engine_start_latency_seconds summary\n"
+    << "banksia_engine_start_latency_seconds_sum " << engineStartLatencySum << "\n"
+    << "banksia_engine_start_latency_seconds_count " << engineStartCnt << "\n";
+    addMetric(stringStream, "banksia_engine_start_latency_max_seconds", "gauge", "Largest engine start latency.", engineStartLatencyMax);
+    
+    stringStream << "# HELP banksia_move_latency_seconds Time from reading a move of an engine to writing the go of its opponent.\n"
+    << "# TYPE banksia_move_latency_seconds summary\n"
+    << "banksia_move_latency_seconds{quantile=\"0.5\"} " << moveLatency.percentile(0.5) << "\n"
+    << "banksia_move_latency_seconds{quantile=\"0.99\"} " << moveLatency.percentile(0.99) << "\n"
+    << "banksia_move_latency_seconds{quantile=\"1\"} " << moveLatency.max() << "\n"
+    << "banksia_move_latency_seconds_count " << moveLatency.count() << "\n";
+    
+    stringStream << "# HELP banksia_engine_nps Average nodes per second of engines.\n"
+    << "# TYPE banksia_engine_nps gauge\n";
+    for(auto && p : engineNodesMap) {
+        auto nps = p.second.second > 0 ? double(p.second.first) / p.second.second : 0.0;
+        stringStream << "banksia_engine_nps{engine=\"" << escapeLabel(p.first) << "\"} " << nps << "\n";
+    }
+    
+    return stringStream.str();
+}
+
+bool Metrics::startServer(int port)
+{
+    if (serverThread) {
+        return true;
+    }
+    
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "Error: cannot init sockets for metrics." << std::endl;
+        return false;
+    }
+#endif
+    
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        std::cerr << "Error: cannot create a socket for metrics." << std::endl;
+        return false;
+    }
+    
+    int yes = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    
+    // local only
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(sock, 8) != 0) {
+        std::cerr << "Error: cannot listen for metrics on port " << port << std::endl;
+        closesocket(sock);
+        return false;
+    }
+    
+    serverRunning = true;
+    serverThread = new std::thread(&Metrics::serve, this, std::uintptr_t(sock));
+    return true;
+}
+
+void Metrics::stopServer()
+{
+    if (serverThread == nullptr) {
+        return;
+    }
+    serverRunning = false;
+    if (serverThread->joinable()) {
+        serverThread->join();
+    }
+    delete serverThread;
+    serverThread = nullptr;
+}
+
+// A minimal HTTP/1.0 server, any request receives the metrics
+void Metrics::serve(std::uintptr_t listenSocket)
+{
+    auto sock = static_cast<socket_xp>(listenSocket);
+    
+    while (serverRunning) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        timeval tv;
+        tv.tv_sec = 0; tv.tv_usec = 500 * 1000;
+        
+        if (select(int(sock) + 1, &readSet, nullptr, nullptr, &tv) <= 0) {
+            continue;
+        }
+        
+        auto client = accept(sock, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        
+        // read the request, content ignored
+        FD_ZERO(&readSet);
+        FD_SET(client, &readSet);
+        tv.tv_sec = 1; tv.tv_usec = 0;
+        if (select(int(client) + 1, &readSet, nullptr, nullptr, &tv) > 0) {
+            char buf[1024];
+            recv(client, buf, sizeof(buf), 0);
+        }
+        
+        auto body = toString();
+        auto response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+            + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        
+        const char* p = response.c_str();
+        auto remain = response.size();
+        while (remain > 0) {
+            auto k = send(client, p, int(remain), 0);
+            if (k <= 0) {
+                break;
+            }
+            p += k; remain -= k;
+        }
+        closesocket(client);
+    }
+    
+    closesocket(sock);
+}
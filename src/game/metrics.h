@@ -0,0 +1,129 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "../base/comm.h"
+
+namespace banksia {
+    
+    // Log-scaled histogram of durations, 4 buckets per doubling from 1 microsecond.
+    // Lock-free, it could be updated from engine threads
+    class LatencyHistogram : public Obj
+    {
+    public:
+        LatencyHistogram();
+        virtual ~LatencyHistogram() {}
+        
+        virtual const char* className() const override { return "LatencyHistogram"; }
+        virtual bool isValid() const override { return true; }
+        virtual std::string toString() const override;
+        
+        void reset();
+        void add(double seconds);
+        
+        i64 count() const { return cnt; }
+        // unit: second
+        double percentile(double p) const;
+        double max() const;
+        
+    private:
+        static const int bucketCnt = 112;
+        std::atomic<i64> buckets[bucketCnt];
+        std::atomic<i64> cnt, maxMicros;
+    };
+    
+    // Live counters of a tournament. They could be read from a local HTTP endpoint
+    // in Prometheus text format (tour JSON, field "metrics")
+    class Metrics : public Obj
+    {
+    public:
+        Metrics();
+        virtual ~Metrics();
+        
+        static Metrics* instance;
+        
+        virtual const char* className() const override { return "Metrics"; }
+        virtual bool isValid() const override { return true; }
+        virtual std::string toString() const override;
+        
+        void reset();
+        
+        // called by the tournament timer, period in seconds
+        void tick(double period);
+        
+        void addEngineStart(double latency);
+        void addEngineNodes(const std::string& name, i64 nodes, double elapsed);
+        
+        bool startServer(int port);
+        void stopServer();
+        
+    public:
+        std::atomic<i64> gameCnt, moveCnt, timeForfeitCnt, crashCnt;
+        std::atomic<int> activeGameCnt, logQueueDepth;
+        
+        // from reading a move of an engine to writing the go of its opponent
+        LatencyHistogram moveLatency;
+        
+    private:
+        void serve(std::uintptr_t listenSocket);
+        
+        static std::string escapeLabel(const std::string& str);
+        
+    private:
+        struct Sample {
+            std::chrono::steady_clock::time_point clock;
+            i64 gameCnt, moveCnt;
+        };
+        
+        mutable std::mutex dataMutex;
+        
+        std::deque<Sample> sampleList; // for rates, within one minute
+        std::chrono::steady_clock::time_point lastTickClock;
+        bool ticked = false;
+        double tickLag = 0, tickLagMax = 0;
+        
+        i64 engineStartCnt = 0;
+        double engineStartLatencySum = 0, engineStartLatencyMax = 0;
+        
+        std::map<std::string, std::pair<i64, double>> engineNodesMap; // name -> nodes, elapsed
+        
+        std::atomic<bool> serverRunning;
+        std::thread* serverThread = nullptr;
+    };
+    
+    extern Metrics metrics;
+    
+} // namespace banksia
+
+#endif /* metrics_h */
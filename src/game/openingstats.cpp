@@ -0,0 +1,166 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "openingstats.h"
+
+using namespace banksia;
+
+Json::Value OpeningRecord::saveToJson() const
+{
+    Json::Value obj;
+    obj["fen"] = startFen;
+    
+    std::string moveString;
+    for(auto && move : startMoves) {
+        if (!moveString.empty()) moveString += " ";
+        moveString += move.toCoordinateString();
+    }
+    obj["moves"] = moveString;
+    
+    obj["games"] = gameCnt;
+    obj["white wins"] = whiteWinCnt;
+    obj["draws"] = drawCnt;
+    obj["black wins"] = blackWinCnt;
+    obj["pairs"] = pairCnt;
+    obj["same pairs"] = samePairCnt;
+    obj["dropped"] = dropped;
+    return obj;
+}
+
+bool OpeningStats::isValid() const
+{
+    return minPairs > 0;
+}
+
+std::string OpeningStats::toString() const
+{
+    auto droppedCnt = 0;
+    for(auto && p : recordMap) {
+        if (p.second.dropped) droppedCnt++;
+    }
+    
+    std::ostringstream stringStream;
+    stringStream << "openings: " << recordMap.size() << ", dropped: " << droppedCnt;
+    return stringStream.str();
+}
+
+bool OpeningStats::load(const Json::Value& obj)
+{
+    mode = obj.isMember("mode") && obj["mode"].asBool();
+    if (obj.isMember("path")) path = obj["path"].asString();
+    dropMode = obj.isMember("drop same pairs") && obj["drop same pairs"].asBool();
+    if (obj.isMember("min pairs")) minPairs = obj["min pairs"].asInt();
+    return isValid();
+}
+
+Json::Value OpeningStats::saveToJson() const
+{
+    Json::Value obj;
+    obj["mode"] = mode;
+    obj["path"] = path;
+    obj["drop same pairs"] = dropMode;
+    obj["min pairs"] = minPairs;
+    return obj;
+}
+
+void OpeningStats::clear()
+{
+    recordMap.clear();
+    pairMap.clear();
+}
+
+bool OpeningStats::add(u64 key, u64 pairKey, const std::string& startFen, const std::vector<Move>& startMoves, ResultType result)
+{
+    auto& r = recordMap[key];
+    if (r.gameCnt == 0) {
+        r.startFen = startFen;
+        r.startMoves = startMoves;
+    }
+    
+    r.gameCnt++;
+    switch (result) {
+        case ResultType::win:
+            r.whiteWinCnt++;
+            break;
+        case ResultType::draw:
+            r.drawCnt++;
+            break;
+        case ResultType::loss:
+            r.blackWinCnt++;
+            break;
+        default:
+            break;
+    }
+    
+    // the second game of a pair with the same opening
+    auto it = pairMap.find(pairKey);
+    if (it == pairMap.end() || it->second.first != key) {
+        pairMap[pairKey] = std::make_pair(key, result);
+        return false;
+    }
+    
+    r.pairCnt++;
+    if (it->second.second == result && result != ResultType::draw) {
+        r.samePairCnt++;
+    }
+    pairMap.erase(it);
+    
+    if (dropMode && !r.dropped && r.pairCnt >= minPairs && r.samePairCnt == r.pairCnt) {
+        r.dropped = true;
+        return true;
+    }
+    return false;
+}
+
+bool OpeningStats::saveFile() const
+{
+    if (path.empty()) {
+        return false;
+    }
+    
+    std::vector<std::pair<u64, const OpeningRecord*>> vec;
+    for(auto && p : recordMap) {
+        vec.push_back(std::make_pair(p.first, &p.second));
+    }
+    std::sort(vec.begin(), vec.end(), [](const std::pair<u64, const OpeningRecord*>& lhs, const std::pair<u64, const OpeningRecord*>& rhs) {
+        return lhs.second->gameCnt > rhs.second->gameCnt || (lhs.second->gameCnt == rhs.second->gameCnt && lhs.first < rhs.first);
+    });
+    
+    Json::Value a = Json::arrayValue;
+    for(auto && p : vec) {
+        auto obj = p.second->saveToJson();
+        std::ostringstream stringStream;
+        stringStream << std::hex << std::setw(16) << std::setfill('0') << p.first;
+        obj["key"] = stringStream.str();
+        a.append(obj);
+    }
+    
+    Json::Value d;
+    d["openings"] = a;
+    return JsonSavable::saveToJsonFile(path, d);
+}
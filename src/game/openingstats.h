@@ -0,0 +1,81 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef openingstats_h
+#define openingstats_h
+
+#include <unordered_map>
+
+#include "../chess/chess.h"
+
+namespace banksia {
+    
+    // Results of an opening, counted from white's view. Two games of a pair (swapped sides) are
+    // the same if white won both or black won both (the opening decides the result). Two draws
+    // are not the same: the opening may be balanced
+    class OpeningRecord
+    {
+    public:
+        Json::Value saveToJson() const;
+        
+    public:
+        std::string startFen;
+        std::vector<Move> startMoves;
+        int gameCnt = 0, whiteWinCnt = 0, drawCnt = 0, blackWinCnt = 0;
+        int pairCnt = 0, samePairCnt = 0;
+        bool dropped = false;
+    };
+    
+    // Results per opening, keyed by hash keys of their last positions
+    class OpeningStats : public Jsonable
+    {
+    public:
+        virtual ~OpeningStats() {}
+        virtual const char* className() const override { return "OpeningStats"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        virtual bool load(const Json::Value& obj) override;
+        virtual Json::Value saveToJson() const override;
+        
+        void clear();
+        
+        // return true if the opening has just been dropped by that result
+        // games of a pair have the same pairKey
+        bool add(u64 key, u64 pairKey, const std::string& startFen, const std::vector<Move>& startMoves, ResultType result);
+        bool saveFile() const;
+        
+    public:
+        bool mode = false, dropMode = false;
+        int minPairs = 2;
+        std::string path;
+        
+    private:
+        std::unordered_map<u64, OpeningRecord> recordMap;
+        std::unordered_map<u64, std::pair<u64, ResultType>> pairMap; // pairKey -> opening, result of the first game
+    };
+    
+} // namespace banksia
+
+#endif /* openingstats_h */
@@ -0,0 +1,149 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <ctime>
+#include <algorithm>
+
+#include "pgnwriter.h"
+
+using namespace banksia;
+
+void PgnWriter::addInt(int value)
+{
+    char s[16];
+    auto n = snprintf(s, sizeof(s), "%d", value);
+    buf.append(s, n);
+}
+
+void PgnWriter::addTag(const char* name, const std::string& value)
+{
+    buf += '[';
+    buf += name;
+    buf += " \"";
+    buf += value;
+    buf += "\"]\n";
+}
+
+void PgnWriter::addTag(const char* name, int value)
+{
+    buf += '[';
+    buf += name;
+    buf += " \"";
+    addInt(value);
+    buf += "\"]\n";
+}
+
+void PgnWriter::addTimeTag(const char* name, const char* format, const std::tm& tm)
+{
+    char s[32];
+    auto n = strftime(s, sizeof(s), format, &tm);
+    addTag(name, std::string(s, n));
+}
+
+void PgnWriter::addMoveText(const ChessBoard& board, bool richMode)
+{
+    auto itemPerLine = richMode ? 4 : 8;
+    char s[64];
+    
+    buf += '\n';
+    
+    auto c = 0;
+    for(size_t i = 0, k = 0; i < board.histList.size(); i++, k++) {
+        auto& hist = board.histList[i];
+        if (i == 0 && hist.move.piece.side == Side::black) k++; // counter should be from event number
+        
+        if (c) buf += ' ';
+        if ((k & 1) == 0) {
+            addInt(static_cast<int>(1 + k / 2));
+            buf += ". ";
+        }
+        
+        buf += hist.moveString;
+        
+        // Comment
+        auto haveComment = false;
+        if (richMode && hist.depth > 0) {
+            haveComment = true;
+            auto n = snprintf(s, sizeof(s), " {%+.1f/%d %.1f", static_cast<double>(hist.score) / 100.0, hist.depth, hist.elapsed);
+            buf.append(s, std::min(n, static_cast<int>(sizeof(s)) - 1));
+        }
+        if (!hist.comment.empty()) {
+            buf += haveComment ? "; " : " {";
+            haveComment = true;
+            buf += hist.comment;
+        }
+        
+        if (haveComment) {
+            buf += "} ";
+        }
+        
+        c++;
+        if (c >= itemPerLine) {
+            c = 0;
+            buf += '\n';
+        }
+    }
+}
+
+void PgnWriter::addResult(const ChessBoard& board)
+{
+    if (board.result.result != ResultType::noresult) {
+        if (board.histList.size() % 8 != 0) buf += ' ';
+        buf += board.result.toShortString();
+        buf += '\n';
+    }
+    buf += '\n';
+}
+
+PgnFile::~PgnFile()
+{
+    close();
+}
+
+bool PgnFile::append(const std::string& _path, const std::string& str)
+{
+    if (file == nullptr || path != _path) {
+        close();
+        file = fopen(_path.c_str(), "a");
+        if (file == nullptr) {
+            return false;
+        }
+        path = _path;
+        buffer.resize(64 * 1024);
+        setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    }
+    
+    fwrite(str.c_str(), 1, str.size(), file);
+    fputc('\n', file);
+    return fflush(file) == 0;
+}
+
+void PgnFile::close()
+{
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    path.clear();
+}
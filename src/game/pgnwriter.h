@@ -0,0 +1,84 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef pgnwriter_h
+#define pgnwriter_h
+
+#include <stdio.h>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "../chess/chess.h"
+
+namespace banksia {
+    
+    // Formats a game into a buffer which is reused for next games (without streams),
+    // the movetext is made of the SAN strings stored in the histList
+    class PgnWriter
+    {
+    public:
+        void clear() {
+            buf.clear();
+        }
+        
+        const std::string& str() const {
+            return buf;
+        }
+        
+        void addTag(const char* name, const std::string& value);
+        void addTag(const char* name, int value);
+        void addTimeTag(const char* name, const char* format, const std::tm& tm);
+        
+        // an empty line then the same as ChessBoard::toMoveListString with SAN and move counters
+        void addMoveText(const ChessBoard& board, bool richMode);
+        void addResult(const ChessBoard& board);
+        
+    private:
+        void addInt(int value);
+        
+    private:
+        std::string buf;
+    };
+    
+    // An appending text file which is kept open (buffered) while the path is unchanged,
+    // the buffer is flushed after every string
+    class PgnFile
+    {
+    public:
+        ~PgnFile();
+        
+        bool append(const std::string& path, const std::string& str);
+        void close();
+        
+    private:
+        std::string path;
+        FILE* file = nullptr;
+        std::vector<char> buffer;
+    };
+    
+} // namespace banksia
+
+#endif /* pgnwriter_h */
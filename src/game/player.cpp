@@ -84,6 +84,16 @@ bool Player::isAttached() const
     return board != nullptr && timeController != nullptr && moveReceiver != nullptr;
 }
 
+bool Player::tickIfDeattached()
+{
+    std::lock_guard<std::mutex> dolock(attachMutex);
+    if (isAttached()) {
+        return false;
+    }
+    tick();
+    return true;
+}
+
 bool Player::goPonder(const Move&)
 {
     return go();
@@ -27,6 +27,9 @@
 #define player_hpp
 
 #include <stdio.h>
+#include <chrono>
+#include <atomic>
+#include <mutex>
 
 #include "../chess/chess.h"
 #include "time.h"
@@ -74,6 +77,10 @@ namespace banksia {
         virtual bool isAttached() const;
         virtual bool isSafeToDeattach() const = 0;
         virtual void prepareToDeattach() = 0;
+        
+        // PlayerMng ticks players which are not attached to games. The check and the tick are done
+        // under attachMutex (taken by attach of engines) thus a game can't take the player in between
+        bool tickIfDeattached();
 
         virtual bool goPonder(const Move& pondermove);
         virtual bool go();
@@ -91,6 +98,28 @@ namespace banksia {
             return nodes;
         }
 
+        // last time receiving data from / writing data to the player
+        std::chrono::steady_clock::time_point getInputClock() const {
+            return ticks2Clock(inputTicks);
+        }
+        
+        std::chrono::steady_clock::time_point getOutputClock() const {
+            return ticks2Clock(outputTicks);
+        }
+        
+    protected:
+        void setInputClock(std::chrono::steady_clock::time_point clock) {
+            inputTicks = clock.time_since_epoch().count();
+        }
+        
+        void setOutputClock(std::chrono::steady_clock::time_point clock) {
+            outputTicks = clock.time_since_epoch().count();
+        }
+        
+        static std::chrono::steady_clock::time_point ticks2Clock(i64 ticks) {
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+        }
+
     protected:
         int idNumber; // a random number, main purpose for debugging
         std::string name;
@@ -101,6 +130,10 @@ namespace banksia {
         // for stats
         int score, depth;
         i64 nodes;
+        std::mutex attachMutex;
+        
+        // ticks of steady_clock, written by the threads of the process and read by the game
+        std::atomic<i64> inputTicks { 0 }, outputTicks { 0 };
         
         bool ponderMode = false;
         
@@ -52,7 +52,8 @@ void PlayerMng::tickWork()
                 removingList.push_back(player);
             }
         } else {
-            player->tick();
+            // attached players are ticked together with their games
+            player->tickIfDeattached();
         }
     }
     
@@ -139,18 +140,19 @@ bool PlayerMng::removePlayer(Player* player)
 Engine* PlayerMng::createEngine(const std::string& name)
 {
     auto config = configMng.get(name);
-    return config.isValid() ? createEngine(config) : nullptr;
+    return config ? createEngine(config) : nullptr;
 }
 
-Engine* PlayerMng::createEngine(const Config& config)
+// engines share the config snapshot, no copy
+Engine* PlayerMng::createEngine(const ConfigPtr& config)
 {
-    if (!config.isValid()) {
+    if (!config || !config->isValid()) {
         return nullptr;
     }
 
     Engine* ePlayer = nullptr;
 
-    switch (config.protocol) {
+    switch (config->protocol) {
         case Protocol::uci:
             ePlayer = new UciEngine(config);
             break;
@@ -46,7 +46,7 @@ namespace banksia {
         virtual void tickWork() override;
         
         Engine* createEngine(const std::string& name);
-        Engine* createEngine(const Config& config);
+        Engine* createEngine(const ConfigPtr& config);
         
         bool add(const Config&);
         bool add(Player* player);
@@ -227,13 +227,13 @@ GameTimeController::~GameTimeController()
 
 void GameTimeController::startMoveTimeClock()
 {
-    moveStartClock = std::chrono::system_clock::now();
+    moveStartClock = std::chrono::steady_clock::now();
 }
 
 // unit: second
 double GameTimeController::moveTimeConsumed() const
 {
-    auto diff = std::chrono::system_clock::now() - moveStartClock;
+    auto diff = std::chrono::steady_clock::now() - moveStartClock;
     auto ms = std::chrono::duration <double, std::milli> (diff).count();
 	assert(ms >= 0);
     return double(ms) / 1000; // convert into second
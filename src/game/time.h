@@ -92,7 +92,7 @@ namespace banksia {
         
         void startMoveTimeClock();
         
-        std::chrono::system_clock::time_point moveStartClock;
+        std::chrono::steady_clock::time_point moveStartClock;
     };
     
 } // namespace banksia
@@ -32,66 +32,124 @@
 #include <cmath>
 
 #include "tourmng.h"
+#include "matching.h"
+#include "metrics.h"
+#include "handshakecache.h"
 
 #include "../3rdparty/json/json.h"
 #include "../3rdparty/fathom/tbprobe.h"
 
 using namespace banksia;
 
+void PlayerRegistry::clear()
+{
+    nameList.clear();
+    idMap.clear();
+}
+
+// Return the id of the name, registered if it is new
+int PlayerRegistry::add(const std::string& name)
+{
+    auto it = idMap.find(name);
+    if (it != idMap.end()) {
+        return it->second;
+    }
+    
+    auto id = int(nameList.size());
+    idMap[name] = id;
+    nameList.push_back(name);
+    return id;
+}
+
+int PlayerRegistry::find(const std::string& name) const
+{
+    auto it = idMap.find(name);
+    return it == idMap.end() ? -1 : it->second;
+}
+
+const std::string& PlayerRegistry::getName(int id) const
+{
+    static const std::string emptyName;
+    return id >= 0 && id < int(nameList.size()) ? nameList[id] : emptyName;
+}
+
+//////////////////////////////
 bool MatchRecord::isValid() const
 {
-    return !playernames[0].empty() && !playernames[1].empty();
+    return playerIds[0] >= 0 && playerIds[1] >= 0;
 }
 
 std::string MatchRecord::toString() const
 {
     std::ostringstream stringStream;
-    stringStream << "names: " << playernames[0] << ", " << playernames[1]
+    stringStream << "player ids: " << playerIds[0] << ", " << playerIds[1]
     << ", status: " << static_cast<int>(state)
     << ", round: " << round;
     return stringStream.str();
 }
 
-bool MatchRecord::load(const Json::Value& obj)
+bool MatchRecord::load(JsonReader& reader, PlayerRegistry& registry)
 {
-    auto array = obj["players"];
-    playernames[0] = array[0].asString();
-    playernames[1] = array[1].asString();
-    
-    if (obj.isMember("startFen")) {
-        startFen = obj["startFen"].asString();
+    if (reader.peek() != JsonReader::ValueType::object) {
+        reader.skipValue();
+        return false;
     }
     
+    playerIds[0] = playerIds[1] = -1;
+    startFen.clear();
     startMoves.clear();
-    if (obj.isMember("startMoves")) {
-        auto array = obj["startMoves"];
-        for (int i = 0; i < int(array.size()); i++){
-            auto k = array[i].asInt();
-            Move m(k & 0xff, k >> 8 & 0xff, static_cast<PieceType>(k >> 16 & 0xff));
-            startMoves.push_back(m);
+    gameIdx = round = pairId = 0;
+    std::string resultString, reasonString;
+    
+    reader.beginObject();
+    for(std::string key; reader.nextMember(key);) {
+        if (key == "players" && reader.peek() == JsonReader::ValueType::array) {
+            reader.beginArray();
+            for(int sd = 0; reader.nextElement(); sd++) {
+                std::string name;
+                if (sd < 2 && reader.peek() == JsonReader::ValueType::string && reader.readString(name)) {
+                    playerIds[sd] = name.empty() ? -1 : registry.add(name);
+                } else {
+                    reader.skipValue();
+                }
+            }
+        } else if (key == "startFen" && reader.peek() == JsonReader::ValueType::string) {
+            reader.readString(startFen);
+        } else if (key == "startMoves" && reader.peek() == JsonReader::ValueType::array) {
+            reader.beginArray();
+            for(int k; reader.nextElement() && reader.readInt(k);) {
+                Move m(k & 0xff, k >> 8 & 0xff, static_cast<PieceType>(k >> 16 & 0xff));
+                startMoves.push_back(m);
+            }
+        } else if (key == "result" && reader.peek() == JsonReader::ValueType::string) {
+            reader.readString(resultString);
+        } else if (key == "reason" && reader.peek() == JsonReader::ValueType::string) {
+            reader.readString(reasonString);
+        } else if (key == "gameIdx" && reader.peek() == JsonReader::ValueType::number) {
+            reader.readInt(gameIdx);
+        } else if (key == "round" && reader.peek() == JsonReader::ValueType::number) {
+            reader.readInt(round);
+        } else if (key == "pairId" && reader.peek() == JsonReader::ValueType::number) {
+            reader.readInt(pairId);
+        } else {
+            reader.skipValue();
         }
     }
     
-    auto s = obj["result"].asString();
-    result.result = string2ResultType(s);
-    s = obj["reason"].asString();
-    result.reason= string2ReasonType(s);
+    result.result = string2ResultType(resultString);
+    result.reason = string2ReasonType(reasonString);
     
     state = result.result == ResultType::noresult ? MatchState::none : MatchState::completed;
-    
-    gameIdx = obj["gameIdx"].asInt();
-    round = obj["round"].asInt();
-    pairId = obj["pairId"].asInt();
-    return true;
+    return !reader.hasError();
 }
 
-Json::Value MatchRecord::saveToJson() const
+Json::Value MatchRecord::saveToJson(const PlayerRegistry& registry) const
 {
     Json::Value obj;
     
     Json::Value players;
-    players.append(playernames[0]);
-    players.append(playernames[1]);
+    players.append(registry.getName(playerIds[0]));
+    players.append(registry.getName(playerIds[1]));
     obj["players"] = players;
     
     if (!startFen.empty()) {
@@ -131,10 +189,140 @@ Elo::Elo(int wins, int draws, int losses) {
     los = .5 + .5 * erf((wins - losses) / sqrt(2.0 * (wins + losses)));
 }
 
+//////////////////////////////
+static const char* sprtResultNames[] = {
+    "none", "H0 accepted", "H1 accepted", nullptr
+};
+
+std::string Sprt::sprtResult2String(SprtResult result)
+{
+    return sprtResultNames[static_cast<int>(result)];
+}
+
+bool Sprt::isValid() const
+{
+    return elo0 < elo1 && alpha > 0 && alpha < 1 && beta > 0 && beta < 1;
+}
+
+std::string Sprt::toString() const
+{
+    std::ostringstream stringStream;
+    stringStream << "elo0: " << elo0 << ", elo1: " << elo1 << ", alpha: " << alpha << ", beta: " << beta;
+    return stringStream.str();
+}
+
+bool Sprt::load(const Json::Value& obj)
+{
+    mode = obj.isMember("mode") && obj["mode"].asBool();
+    if (obj.isMember("player")) playerName = obj["player"].asString();
+    if (obj.isMember("elo0")) elo0 = obj["elo0"].asDouble();
+    if (obj.isMember("elo1")) elo1 = obj["elo1"].asDouble();
+    if (obj.isMember("alpha")) alpha = obj["alpha"].asDouble();
+    if (obj.isMember("beta")) beta = obj["beta"].asDouble();
+    return isValid();
+}
+
+Json::Value Sprt::saveToJson() const
+{
+    Json::Value obj;
+    obj["mode"] = mode;
+    obj["player"] = playerName;
+    obj["elo0"] = elo0;
+    obj["elo1"] = elo1;
+    obj["alpha"] = alpha;
+    obj["beta"] = beta;
+    return obj;
+}
+
+double Sprt::elo2Score(double elo)
+{
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+double Sprt::lowerBound() const
+{
+    return log(beta / (1.0 - alpha));
+}
+
+double Sprt::upperBound() const
+{
+    return log((1.0 - beta) / alpha);
+}
+
+// https://www.chessprogramming.org/Match_Statistics#SPRT
+// LLR ~ N * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance)
+double Sprt::getLLR(const i64* counts, int n) const
+{
+    assert(n >= 2);
+    double total = 0;
+    for(int i = 0; i < n; i++) {
+        total += double(counts[i]);
+    }
+    if (total < 2) {
+        return 0;
+    }
+
+    // regularize empty buckets, otherwise a one-sided result never gets a variance
+    std::vector<double> freqs(n);
+    double sum = 0, mean = 0;
+    for(int i = 0; i < n; i++) {
+        freqs[i] = counts[i] > 0 ? double(counts[i]) : 1e-3;
+        sum += freqs[i];
+    }
+    for(int i = 0; i < n; i++) {
+        freqs[i] /= sum;
+        mean += freqs[i] * i / (n - 1);
+    }
+
+    double variance = 0;
+    for(int i = 0; i < n; i++) {
+        auto d = double(i) / (n - 1) - mean;
+        variance += freqs[i] * d * d;
+    }
+    if (variance <= 0) {
+        return 0;
+    }
+
+    auto s0 = elo2Score(elo0), s1 = elo2Score(elo1);
+    return total * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+SprtResult Sprt::check(double llr) const
+{
+    if (llr >= upperBound()) {
+        return SprtResult::h1;
+    }
+    if (llr <= lowerBound()) {
+        return SprtResult::h0;
+    }
+    return SprtResult::none;
+}
+
+void SprtStats::clear()
+{
+    for(int i = 0; i < 5; i++) penta[i] = 0;
+    for(int i = 0; i < 3; i++) trino[i] = 0;
+    pairMap.clear();
+}
+
+void SprtStats::add(int halfPoints, u64 pairKey)
+{
+    assert(halfPoints >= 0 && halfPoints <= 2);
+    trino[halfPoints]++;
+    
+    auto& p = pairMap[pairKey];
+    p.first++;
+    p.second += halfPoints;
+    if ((p.first & 1) == 0) {
+        penta[p.second]++;
+        p.second = 0;
+    }
+}
+
 //////////////////////////////
 bool TourPlayer::isValid() const
 {
-    return !name.empty()
+    return playerId >= 0
     && gameCnt >= 0 && winCnt >= 0 && drawCnt>= 0 && lossCnt>= 0
     && gameCnt == winCnt + drawCnt + lossCnt;
 }
@@ -142,7 +330,7 @@ bool TourPlayer::isValid() const
 std::string TourPlayer::toString() const
 {
     std::ostringstream stringStream;
-    stringStream << name << "#games: "<< gameCnt << ", wdl: " << winCnt << ", " << drawCnt << ", " << lossCnt;
+    stringStream << "player id: " << playerId << ", #games: "<< gameCnt << ", wdl: " << winCnt << ", " << drawCnt << ", " << lossCnt;
     return stringStream.str();
 }
 
@@ -262,7 +450,10 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         ConfigMng::instance->loadOverrideOptions(d[s]);
     }
     
-    // Participants
+    handshakeCache.load();
+    
+    // Participants, registered first thus their ids are from 0
+    playerRegistry.clear();
     participantList.clear();
     if (d.isMember("players")) {
         const Json::Value& array = d["players"];
@@ -270,7 +461,7 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
             auto str = array[i].isString() ? array[i].asString() : "";
             if (!str.empty()) {
                 if (ConfigMng::instance->isNameExistent(str)) {
-                    participantList.push_back(str);
+                    participantList.push_back(playerRegistry.add(str));
                 } else {
                     std::cerr << "Error: player " << str << " (in \"players\") is not existent in engine configurations." << std::endl;
                 }
@@ -278,7 +469,7 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         }
     }
     
-    inclusivePlayers.clear();
+    std::vector<std::string> inclusiveNames;
     s = "inclusive players";
     if (d.isMember(s)) {
         auto v = d[s];
@@ -293,7 +484,7 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
                 auto str = array[i].isString() ? array[i].asString() : "";
                 if (!str.empty()) {
                     if (ConfigMng::instance->isNameExistent(str)) {
-                        inclusivePlayers.insert(str);
+                        inclusiveNames.push_back(str);
                     } else {
                         std::cerr << "Error: player " << str << " (in \"inclusive Players\") is not existent in engine configurations." << std::endl;
                     }
@@ -322,7 +513,16 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
     
     if (participantList.empty()) {
         std::cerr << "Warning: missing parametter \"players\". Will use all players in configure instead." << std::endl;
-        participantList = ConfigMng::instance->nameList();
+        for(auto && name : ConfigMng::instance->nameList()) {
+            participantList.push_back(playerRegistry.add(name));
+        }
+    }
+    
+    inclusivePlayers.clear();
+    for(auto && name : inclusiveNames) {
+        auto id = playerRegistry.add(name);
+        inclusivePlayers.resize(std::max(int(inclusivePlayers.size()), id + 1), false);
+        inclusivePlayers[id] = true;
     }
     
     if (participantList.size() < 2) {
@@ -350,6 +550,9 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         configMng.setSyzygyPath(obj["syzygypath"].asString());
     }
     
+    // all overrides are known now
+    ConfigMng::instance->prepareOptionCommands();
+    
     s = "game adjudication";
     if (d.isMember(s)) {
         auto obj = d[s];
@@ -358,7 +561,58 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
         gameConfig.adjudicationMaxGameLength = obj.isMember("draw if game length over") ? obj["draw if game length over"].asInt() : 0;
         gameConfig.adjudicationMaxPieces = obj.isMember("tablebase max pieces") ? obj["tablebase max pieces"].asInt() : 10;
     }
-    
+
+    s = "sprt";
+    if (d.isMember(s)) {
+        if (!sprt.load(d[s]) && sprt.mode) {
+            std::cerr << "Error: parametter \"" << s << "\" is incorrect (should be elo0 < elo1, 0 < alpha, beta < 1). SPRT is off" << std::endl;
+            sprt.mode = false;
+        }
+
+        sprtPlayerId = -1;
+        if (sprt.mode) {
+            // the tested player: given one, the only inclusive player or the first one
+            if (sprt.playerName.empty()) {
+                sprt.playerName = inclusivePlayerMode && inclusiveNames.size() == 1 ? inclusiveNames.front() : playerRegistry.getName(participantList.front());
+            }
+            sprtPlayerId = playerRegistry.find(sprt.playerName);
+            if (std::find(participantList.begin(), participantList.end(), sprtPlayerId) == participantList.end()) {
+                std::cerr << "Error: player " << sprt.playerName << " (in \"" << s << "\") is not in \"players\". SPRT is off" << std::endl;
+                sprt.mode = false;
+                sprtPlayerId = -1;
+            }
+        }
+    }
+
+    s = "opening stats";
+    if (d.isMember(s)) {
+        if (!openingStats.load(d[s]) && openingStats.mode) {
+            std::cerr << "Error: parametter \"" << s << "\" is incorrect (should be min pairs > 0). Opening stats is off" << std::endl;
+            openingStats.mode = false;
+        }
+        if (openingStats.dropMode && bookMng.getBookSelectType() == BookSelectType::allone) {
+            openingStats.dropMode = false;
+        }
+        // without swapping, one engine wins both games of a pair by itself, not by the opening
+        if (openingStats.dropMode && !swapPairSides) {
+            std::cerr << "Warning: \"drop same pairs\" (in \"" << s << "\") needs \"swap pair sides\" on. It is off" << std::endl;
+            openingStats.dropMode = false;
+        }
+    }
+
+    s = "metrics";
+    if (d.isMember(s)) {
+        auto obj = d[s];
+        metricsMode = obj.isMember("mode") && obj["mode"].asBool();
+        if (obj.isMember("port")) {
+            metricsPort = obj["port"].asInt();
+        }
+        if (metricsMode && (metricsPort <= 0 || metricsPort > 65535)) {
+            std::cerr << "Error: port " << metricsPort << " (in \"" << s << "\") is incorrect. Metrics is off" << std::endl;
+            metricsMode = false;
+        }
+    }
+
     s = "logs";
     if (d.isMember(s)) {
         auto a = d[s];
@@ -372,6 +626,20 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
             logPgnRichMode = v.isMember("rich info") && v["rich info"].asBool();
         }
         
+        s = "archive";
+        if (a.isMember(s)) {
+            auto v = a[s];
+            archiveMode = v.isMember("mode") && v["mode"].asBool();
+            archivePath = v["path"].asString();
+        }
+        
+        s = "training data";
+        if (a.isMember(s)) {
+            auto v = a[s];
+            trainingDataMode = v.isMember("mode") && v["mode"].asBool();
+            trainingDataPath = v["path"].asString();
+        }
+        
         s = "engine";
         if (a.isMember(s)) {
             auto v = a[s];
@@ -430,34 +698,38 @@ bool TourMng::parseJsonAfterLoading(Json::Value& d)
 
 void TourMng::tickWork()
 {
+    metrics.tick(0.5);
+    
+    // players of games are ticked by their games
     playerMng.tick();
     
     std::vector<Game*> stoppedGameList;
     
     for(auto && game : gameList) {
-        game->tick();
-        auto st = game->getState();
-        switch (st) {
-            case GameState::stopped:
-                game->setState(GameState::ending);
-                matchCompleted(game);
-                break;
-                
-            case GameState::ended:
-            {
-                for(int sd = 0; sd < 2; sd++) {
-                    auto side = static_cast<Side>(sd);
-                    auto player = game->getPlayer(side);
-                    if (player) {
-                        player->quit();
-                    }
+        // the previous task of this game is still running
+        if (game->scheduled) {
+            continue;
+        }
+        
+        if (game->getState() == GameState::ended) {
+            for(int sd = 0; sd < 2; sd++) {
+                auto side = static_cast<Side>(sd);
+                auto player = game->getPlayer(side);
+                if (player) {
+                    player->quit();
                 }
-                
-                stoppedGameList.push_back(game);
-                break;
             }
-            default:
-                break;
+            
+            stoppedGameList.push_back(game);
+            continue;
+        }
+        
+        game->scheduled = true;
+        if (!workerPool.submit([this, game]() {
+            tickGame(game);
+            game->scheduled = false;
+        })) {
+            game->scheduled = false;
         }
     }
     
@@ -483,6 +755,29 @@ void TourMng::tickWork()
     if (state == TourState::playing) {
         playMatches();
     }
+    
+    metrics.activeGameCnt = int(gameList.size());
+}
+
+// Run by a worker thread, never at the same time for a given game
+void TourMng::tickGame(Game* game)
+{
+    for(int sd = 0; sd < 2; sd++) {
+        auto player = game->getPlayer(static_cast<Side>(sd));
+        if (player && player->getState() != PlayerState::stopped) {
+            player->tick();
+        }
+    }
+    
+    game->tick();
+    
+    if (game->getState() == GameState::stopped) {
+        game->setState(GameState::ending);
+        matchCompleted(game);
+        
+        // the game may be ended now, ready to be removed by the next tick
+        game->tick();
+    }
 }
 
 static std::string bool2OnOffString(bool b)
@@ -546,12 +841,25 @@ void TourMng::showTournamentInfo()
     + ", concurrency: " + std::to_string(gameConcurrency)
     + ", ponder: " + bool2OnOffString(gameConfig.ponderMode)
     + ", book: " + bool2OnOffString(!bookMng.isEmpty());
-    
+
+    if (sprt.mode) {
+        info += "\nsprt: " + sprt.playerName + ", " + sprt.toString() + (isPentanomialMode() ? ", pentanomial" : ", trinomial");
+    }
+
+    if (openingStats.mode) {
+        info += "\nopening stats: " + (openingStats.path.empty() ? std::string("no file") : openingStats.path) + ", drop same pairs: " + bool2OnOffString(openingStats.dropMode);
+    }
+
     matchLog(info, true);
     
     showPathInfo("pgn", pgnPath, pgnPathMode);
+    showPathInfo("archive", archivePath, archiveMode);
+    showPathInfo("training data", trainingDataPath, trainingDataMode);
     showPathInfo("result", logResultPath, logResultMode);
     showPathInfo("engines", logEnginePath, logEngineMode);
+    if (metricsMode) {
+        std::cout << " metrics: http://127.0.0.1:" << metricsPort << "/metrics" << std::endl;
+    }
     std::cout << std::endl;
 }
 
@@ -562,12 +870,34 @@ void TourMng::startTournament()
     // tickWork will start the matches
     state = TourState::playing;
     
+    if (metricsMode && !metrics.startServer(metricsPort)) {
+        metricsMode = false;
+    }
+    
+    auto cores = std::max(1, getNumberOfCores());
+    workerPool.start(std::max(2, std::min(cores, gameConcurrency)));
+    completionQueue.start();
+    
+    if (archiveMode && (archivePath.empty() || !gameArchive.open(archivePath, eventName, siteName, timeController.toString()))) {
+        archiveMode = false;
+    }
+    if (trainingDataMode && (trainingDataPath.empty() || !trainingDataWriter.open(trainingDataPath))) {
+        trainingDataMode = false;
+    }
+    
     mainTimerId = timer.add(std::chrono::milliseconds(500), [=](CppTime::timer_id) { tick(); }, std::chrono::milliseconds(500));
 }
 
 void TourMng::finishTournament()
 {
     state = TourState::done;
+    
+    // wait for running games to complete their ticks and their bookkeeping
+    workerPool.stop();
+    completionQueue.stop();
+    pgnFile.close();
+    gameArchive.close();
+    trainingDataWriter.close();
     auto elapsed_secs = previousElapsed + static_cast<int>(time(nullptr) - startTime);
     
     if (!matchRecordList.empty()) {
@@ -587,12 +917,23 @@ void TourMng::finishTournament()
 
 void TourMng::playMatches()
 {
-    if (matchRecordList.empty()) {
-        return finishTournament();
+    std::unique_lock<OwnedMutex> dolock(recordMutex);
+    if (!startMatches()) {
+        dolock.unlock();
+        finishTournament();
     }
-    
+}
+
+// Return false when there is nothing left to play. The caller holds recordMutex,
+// next rounds are paired from the standings
+bool TourMng::startMatches()
+{
+    if (matchRecordList.empty() || sprtResult != SprtResult::none) {
+        return false;
+    }
+
     if (gameList.size() >= gameConcurrency) {
-        return;
+        return true;
     }
     
     for(auto && m : matchRecordList) {
@@ -608,14 +949,13 @@ void TourMng::playMatches()
         }
     }
     
-    if (gameList.empty() && !createNextRoundMatches()) {
-        return finishTournament();
-    }
+    // the next round is paired by standings which are updated by the completion queue
+    return !gameList.empty() || completionQueue.pending() > 0 || createNextRoundMatches();
 }
 
 void TourMng::addMatchRecord(MatchRecord& record)
 {
-    record.pairId = std::rand();
+    record.pairId = nextPairId++;
     for(int i = 0; i < gameperpair; i++) {
         addMatchRecord_simple(record);
         if (swapPairSides) {
@@ -627,9 +967,12 @@ void TourMng::addMatchRecord(MatchRecord& record)
 void TourMng::addMatchRecord_simple(MatchRecord& record)
 {
     if (inclusivePlayerMode) {
-        auto ok = inclusivePlayerSide != Side::black && inclusivePlayers.find(record.playernames[W]) != inclusivePlayers.end();
+        auto isInclusive = [&](int id) {
+            return id >= 0 && id < int(inclusivePlayers.size()) && inclusivePlayers[id];
+        };
+        auto ok = inclusivePlayerSide != Side::black && isInclusive(record.playerIds[W]);
         if (!ok) {
-            ok = inclusivePlayerSide != Side::white && inclusivePlayers.find(record.playernames[B]) != inclusivePlayers.end();
+            ok = inclusivePlayerSide != Side::white && isInclusive(record.playerIds[B]);
             
             if (!ok) {
                 return;
@@ -637,8 +980,12 @@ void TourMng::addMatchRecord_simple(MatchRecord& record)
         }
     }
     record.gameIdx = int(matchRecordList.size());
+    pairStartMap.emplace(record.pairId, record.gameIdx);
     bookMng.getRandomBook(record.pairId, record.startFen, record.startMoves);
     matchRecordList.push_back(record);
+    
+    // bye records are completed from the beginning
+    addToStandings(record);
 }
 
 bool TourMng::createNextRoundMatches()
@@ -670,8 +1017,8 @@ void TourMng::checkToExtendMatches(int gIdx)
     for(auto && r : matchRecordList) {
         if (r.gameIdx == gIdx) {
             TourPlayerPair playerPair;
-            playerPair.pair[0].name = r.playernames[0];
-            playerPair.pair[1].name = r.playernames[1];
+            playerPair.pair[0].playerId = r.playerIds[0];
+            playerPair.pair[1].playerId = r.playerIds[1];
             auto pairId = r.pairId;
             
             for(auto && rcd : matchRecordList) {
@@ -686,10 +1033,10 @@ void TourMng::checkToExtendMatches(int gIdx)
                 if (rcd.result.result != ResultType::win && rcd.result.result  != ResultType::loss) {
                     continue;
                 }
-                auto winnerName = rcd.playernames[(rcd.result.result  == ResultType::win ? W : B)];
-                playerPair.pair[playerPair.pair[W].name == winnerName ? W : B].winCnt++;
+                auto winnerId = rcd.playerIds[(rcd.result.result  == ResultType::win ? W : B)];
+                playerPair.pair[playerPair.pair[W].playerId == winnerId ? W : B].winCnt++;
                 
-                auto whiteIdx = playerPair.pair[W].name == rcd.playernames[W] ? W : B;
+                auto whiteIdx = playerPair.pair[W].playerId == rcd.playerIds[W] ? W : B;
                 playerPair.pair[whiteIdx].whiteCnt++;
             }
             
@@ -700,7 +1047,7 @@ void TourMng::checkToExtendMatches(int gIdx)
                 record.state = MatchState::none;
                 addMatchRecord_simple(record);
                 
-                auto str = "* Tied! Add one more game for " + record.playernames[W] + " vs " + record.playernames[B];
+                auto str = "* Tied! Add one more game for " + playerRegistry.getName(record.playerIds[W]) + " vs " + playerRegistry.getName(record.playerIds[B]);
                 matchLog(str, banksiaVerbose);
             }
             break;
@@ -720,6 +1067,7 @@ int TourMng::getLastRound() const
 void TourMng::reset()
 {
     matchRecordList.clear();
+    rebuildStandings();
     previousElapsed = 0;
 }
 
@@ -728,19 +1076,19 @@ bool TourMng::createMatchList()
     return createMatchList(participantList, type);
 }
 
-bool TourMng::createMatchList(std::vector<std::string> nameList, TourType tourType)
+bool TourMng::createMatchList(std::vector<int> playerIdList, TourType tourType)
 {
     reset();
     
-    if (nameList.size() < 2) {
-        std::cerr << "Error: not enough players (" << nameList.size() << ") and/or unknown tournament type" << std::endl;
+    if (playerIdList.size() < 2) {
+        std::cerr << "Error: not enough players (" << playerIdList.size() << ") and/or unknown tournament type" << std::endl;
         return false;
     }
     
     if (shufflePlayers) {
         auto rng = std::default_random_engine {};
         rng.seed((unsigned int)std::chrono::system_clock::now().time_since_epoch().count());
-        std::shuffle(std::begin(nameList), std::end(nameList), rng);
+        std::shuffle(std::begin(playerIdList), std::end(playerIdList), rng);
     }
     
     std::string missingName;
@@ -748,21 +1096,21 @@ bool TourMng::createMatchList(std::vector<std::string> nameList, TourType tourTy
     switch (tourType) {
         case TourType::roundrobin:
         {
-            for(int i = 0; i < nameList.size() - 1 && !err; i++) {
-                auto name0 = nameList.at(i);
-                if (!ConfigMng::instance->isNameExistent(name0)) {
-                    err = true; missingName = name0;
+            for(int i = 0; i < playerIdList.size() - 1 && !err; i++) {
+                auto id0 = playerIdList.at(i);
+                if (!ConfigMng::instance->isNameExistent(playerRegistry.getName(id0))) {
+                    err = true; missingName = playerRegistry.getName(id0);
                     break;
                 }
-                for(int j = i + 1; j < nameList.size(); j++) {
-                    auto name1 = nameList.at(j);
-                    if (!ConfigMng::instance->isNameExistent(name1)) {
-                        err = true; missingName = name1;
+                for(int j = i + 1; j < playerIdList.size(); j++) {
+                    auto id1 = playerIdList.at(j);
+                    if (!ConfigMng::instance->isNameExistent(playerRegistry.getName(id1))) {
+                        err = true; missingName = playerRegistry.getName(id1);
                         break;
                     }
                     
-                    // random swap to avoid name0 player plays all white side
-                    MatchRecord record(name0, name1, swapPairSides && (rand() & 1));
+                    // random swap to avoid id0 player plays all white side
+                    MatchRecord record(id0, id1, swapPairSides && (rand() & 1));
                     record.round = 1;
                     addMatchRecord(record);
                 }
@@ -776,7 +1124,7 @@ bool TourMng::createMatchList(std::vector<std::string> nameList, TourType tourTy
         case TourType::knockout:
         case TourType::swiss:
         {
-            pairingMatchList(nameList);
+            pairingMatchList(playerIdList);
             break;
         }
             
@@ -796,8 +1144,8 @@ bool TourMng::createMatchList(std::vector<std::string> nameList, TourType tourTy
 void TourMng::createMatch(MatchRecord& record)
 {
     if (!record.isValid() ||
-        !createMatch(record.gameIdx, record.playernames[W], record.playernames[B], record.startFen, record.startMoves)) {
-        std::cerr << "Error: match record invalid or missing players " << record.toString() << std::endl;
+        !createMatch(record.gameIdx, record.playerIds[W], record.playerIds[B], record.startFen, record.startMoves)) {
+        std::cerr << "Error: match record invalid or missing players " << playerRegistry.getName(record.playerIds[W]) << ", " << playerRegistry.getName(record.playerIds[B]) << ", " << record.toString() << std::endl;
         record.state = MatchState::error;
         return;
     }
@@ -805,12 +1153,12 @@ void TourMng::createMatch(MatchRecord& record)
     record.state = MatchState::playing;
 }
 
-bool TourMng::createMatch(int gameIdx, const std::string& whiteName, const std::string& blackName,
+bool TourMng::createMatch(int gameIdx, int whiteId, int blackId,
                           const std::string& startFen, const std::vector<Move>& startMoves)
 {
     Engine* engines[2];
-    engines[W] = playerMng.createEngine(whiteName);
-    engines[B] = playerMng.createEngine(blackName);
+    engines[W] = playerMng.createEngine(playerRegistry.getName(whiteId));
+    engines[B] = playerMng.createEngine(playerRegistry.getName(blackId));
     
     if (engines[0] && engines[1]) {
         auto game = new Game(engines[W], engines[B], timeController, gameConfig);
@@ -850,8 +1198,6 @@ std::vector<TourPlayer> TourMng::getKnockoutWinnerList()
     std::vector<TourPlayer> winList;
     auto lastRound = getLastRound();
     
-    std::set<std::string> lostSet;
-    std::vector<std::string> nameList;
     std::map<int, TourPlayerPair> pairMap;
     
     for(auto && r : matchRecordList) {
@@ -864,16 +1210,16 @@ std::vector<TourPlayer> TourMng::getKnockoutWinnerList()
         auto it = pairMap.find(r.pairId);
         if (it != pairMap.end()) thePair = it->second;
         else {
-            thePair.pair[0].name = r.playernames[0];
-            thePair.pair[1].name = r.playernames[1];
+            thePair.pair[0].playerId = r.playerIds[0];
+            thePair.pair[1].playerId = r.playerIds[1];
         }
         
         if (r.result.result == ResultType::win || r.result.result == ResultType::loss) {
-            auto idxW = thePair.pair[W].name == r.playernames[W] ? W : B;
+            auto idxW = thePair.pair[W].playerId == r.playerIds[W] ? W : B;
             auto winIdx = r.result.result == ResultType::win ? idxW : (1 - idxW);
             thePair.pair[winIdx].winCnt++;
         }
-        auto whiteSd = thePair.pair[W].name == r.playernames[W] ? W : B;
+        auto whiteSd = thePair.pair[W].playerId == r.playerIds[W] ? W : B;
         thePair.pair[whiteSd].whiteCnt++;
         pairMap[r.pairId] = thePair;
     }
@@ -905,79 +1251,35 @@ bool TourMng::createNextSwisstMatchList()
     if (round >= swissRounds) {
         return false;
     }
-    auto list = collectStats();
+    auto list = collectStats(); // under recordMutex of playMatches
     return pairingMatchList(list, round);
 }
 
-bool TourMng::pairingMatchList(const std::vector<std::string>& nameList)
+bool TourMng::pairingMatchList(const std::vector<int>& playerIdList)
 {
     std::vector<TourPlayer> vec;
-    for(auto && name : nameList) {
+    for(auto && id : playerIdList) {
         TourPlayer tourPlayer;
-        tourPlayer.name = name;
+        tourPlayer.playerId = id;
         vec.push_back(tourPlayer);
     }
     
     return pairingMatchList(vec, 0);
 }
 
-bool TourMng::pairingMatchListRecusive(std::vector<TourPlayer>& playerVec, int round, const std::set<std::string>& pairedSet)
-{
-    auto n = playerVec.size(); assert((n & 1) == 0); // must be even
-    
-    auto r = true;
-    for(int i = 0; i < n; ++i) {
-        auto& player0 = playerVec.at(i);
-        if (player0.flag & 1) continue;
-        r = false;
-        auto name0 = player0.name;
-        player0.flag |= 1;
-        
-        for(int j = i + 1; j < n; ++j) {
-            auto& player1 = playerVec.at(j);
-            if (player1.flag & 1) continue;
-            auto name1 = player1.name;
-            
-            if (pairedSet.find(name0 + "*" + name1) != pairedSet.end()) {
-                continue;
-            }
-            
-            player1.flag |= 1;
-            
-            if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
-                player1.flag &= ~1;
-                continue;
-            }
-            
-            // random swap to avoid name0 player plays all white side
-            auto swap = rand() & 1;
-            
-            if (type == TourType::swiss) {
-                swap = player0.whiteCnt > player1.whiteCnt;
-            }
-            MatchRecord record(name0, name1, swapPairSides && swap);
-            record.round = round;
-            addMatchRecord(record);
-            return true;
-        }
-        player0.flag &= ~1;
-        
-    }
-    return r;
-}
-
 bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
 {
     if (playerVec.size() < 2) {
         if (playerVec.size() == 1) {
-            auto str = "\n* The winner is " + playerVec.front().name;
+            auto str = "\n* The winner is " + playerRegistry.getName(playerVec.front().playerId);
             matchLog(str, true);
         }
         return false;
     }
     
-    // odd/bye players, one won't have opponent and he is lucky to set win
-    if (playerVec.size() & 1) {
+    // knockout: odd/bye players, one won't have opponent and he is lucky to set win
+    // swiss: the bye is a part of the pairing, given to a low ranked player
+    if (type != TourType::swiss && (playerVec.size() & 1)) {
         auto luckyIdx = -1;
         for (int i = 0; i < 10; i++) {
             auto k = std::rand() % playerVec.size();
@@ -1009,37 +1311,18 @@ bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
             playerVec.erase(it);
         }
         
-        
-        // the odd player wins all games in the round
-        MatchRecord record(luckPlayer.name, "", false);
-        record.round = round;
-        record.state = MatchState::completed;
-        record.result.result = ResultType::win; // win
-        record.pairId = std::rand();
-        addMatchRecord_simple(record);
-        
-        auto str = "\n* Player " + luckPlayer.name + " is an odd one (no opponent to pair with) and receives a bye (a win) for round " + std::to_string(round + 1);
-        matchLog(str, banksiaVerbose);
+        addByeRecord(luckPlayer.playerId, round);
     }
     
-    std::sort(playerVec.begin(), playerVec.end(), [](const TourPlayer& lhs, const TourPlayer& rhs)
-              {
-                  return lhs.getScore() > rhs.getScore();
-              });
-    
-    std::set<std::string> pairedSet;
-    for(auto && m : matchRecordList) {
-        if (m.playernames[0].empty() || m.playernames[1].empty()) continue;
-        pairedSet.insert(m.playernames[0] + "*" + m.playernames[1]);
-    }
+    // stable to keep the seeding order of players having same scores
+    std::stable_sort(playerVec.begin(), playerVec.end(), [](const TourPlayer& lhs, const TourPlayer& rhs)
+                     {
+                         return lhs.getScore() > rhs.getScore();
+                     });
     
-    if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
-        std::cout << "Warning: All players have played together already." << std::endl;
-        pairedSet.clear();
-        if (!pairingMatchListRecusive(playerVec, round, pairedSet)) {
-            std::cerr << "Error: cannot pair players." << std::endl;
-            return false;
-        }
+    if (!pairingByMatching(playerVec, round)) {
+        std::cerr << "Error: cannot pair players." << std::endl;
+        return false;
     }
     
     std::string str = "\n" + std::string(tourTypeNames[static_cast<int>(type)]) + " round: " + std::to_string(round + 1);
@@ -1052,6 +1335,131 @@ bool TourMng::pairingMatchList(std::vector<TourPlayer> playerVec, int round)
     return true;
 }
 
+void TourMng::addByeRecord(int playerId, int round)
+{
+    // the odd player wins all games in the round
+    MatchRecord record(playerId, -1, false);
+    record.round = round;
+    record.state = MatchState::completed;
+    record.result.result = ResultType::win; // win
+    record.pairId = nextPairId++;
+    addMatchRecord_simple(record);
+    
+    auto str = "\n* Player " + playerRegistry.getName(playerId) + " is an odd one (no opponent to pair with) and receives a bye (a win) for round " + std::to_string(round + 1);
+    matchLog(str, banksiaVerbose);
+}
+
+// Dutch-style pairing as a maximum weighted matching over all players (sorted by scores).
+// Criteria, from the most important: number of pairs, no rematches, small score differences
+// (players meet ones of their score groups, floaters are few), colour preferences,
+// then the top half of a score group meets the bottom half in order (1 vs n/2+1, 2 vs n/2+2...).
+// Each criterion has a weight scale larger than the total of all the ones after it.
+// When the number of players is odd, a virtual player stands for the bye
+bool TourMng::pairingByMatching(const std::vector<TourPlayer>& playerVec, int round)
+{
+    auto n = int(playerVec.size());
+    auto hasBye = (n & 1) != 0;
+    auto vertexCnt = n + (hasBye ? 1 : 0);
+    
+    // player ids -> indexes of playerVec
+    std::vector<int> idxList(playerRegistry.size(), -1);
+    for(int i = 0; i < n; i++) {
+        idxList[playerVec.at(i).playerId] = i;
+    }
+    
+    // how many times each pair has met
+    std::vector<int> metCnt(n * n, 0);
+    std::set<int> countedPairIds;
+    for(auto && m : matchRecordList) {
+        if (m.isBye()) continue;
+        auto i0 = idxList[m.playerIds[0]], i1 = idxList[m.playerIds[1]];
+        if (i0 < 0 || i1 < 0 || !countedPairIds.insert(m.pairId).second) continue;
+        metCnt[i0 * n + i1]++;
+        metCnt[i1 * n + i0]++;
+    }
+    
+    std::vector<int> scores(n), colours(n), groupPos(n), groupSizes(n);
+    for(int i = 0, groupStart = 0; i < n; i++) {
+        auto& p = playerVec.at(i);
+        scores[i] = int(p.getScore() * 2 + 0.5); // in half points
+        colours[i] = type == TourType::swiss ? p.whiteCnt * 2 - (p.gameCnt - p.byeCnt) : 0; // whites - blacks
+        if (i > 0 && scores[i] != scores[i - 1]) {
+            groupStart = i;
+        }
+        groupPos[i] = i - groupStart;
+    }
+    for(int i = n - 1, groupEnd = n; i >= 0; i--) {
+        if (i < n - 1 && scores[i] != scores[i + 1]) {
+            groupEnd = i + 1;
+        }
+        groupSizes[i] = groupEnd - i + groupPos[i];
+    }
+    
+    auto maxMet = 0;
+    for(auto && c : metCnt) maxMet = std::max(maxMet, c);
+    for(auto && p : playerVec) maxMet = std::max(maxMet, p.byeCnt);
+    auto maxScoreDiff = n > 0 ? scores.front() - scores.back() : 0;
+    
+    i64 pairCnt = vertexCnt / 2 + 1;
+    i64 colourScale = pairCnt * n + 1;
+    i64 scoreScale = pairCnt * 2 * colourScale + 1;
+    i64 metScale = pairCnt * maxScoreDiff * scoreScale + 1;
+    i64 maxPenalty = maxMet * metScale + maxScoreDiff * scoreScale + 2 * colourScale + n;
+    i64 base = pairCnt * (maxPenalty + 1); // any larger matching is better
+    
+    WeightedMatching matching(vertexCnt);
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) {
+            i64 penalty = metCnt[i * n + j] * metScale + (scores[i] - scores[j]) * scoreScale;
+            if (colours[i] * colours[j] > 0) { // same colour preferences
+                penalty += std::min(2, std::min(std::abs(colours[i]), std::abs(colours[j]))) * colourScale;
+            }
+            if (scores[i] == scores[j]) {
+                penalty += std::abs(groupPos[j] - groupPos[i] - groupSizes[i] / 2);
+            }
+            matching.setWeight(i, j, base - penalty);
+        }
+        
+        if (hasBye) { // lowest ranked one without byes
+            i64 penalty = playerVec.at(i).byeCnt * metScale + (scores[i] - scores.back()) * scoreScale + (n - 1 - i);
+            matching.setWeight(i, n, base - penalty);
+        }
+    }
+    
+    auto mates = matching.solve();
+    
+    auto rematchCnt = 0;
+    for(int i = 0; i < vertexCnt; i++) {
+        auto j = mates.at(i);
+        if (j < 0) {
+            return false;
+        }
+        if (j < i) {
+            continue;
+        }
+        
+        if (j == n) {
+            addByeRecord(playerVec.at(i).playerId, round);
+            continue;
+        }
+        
+        if (metCnt[i * n + j]) {
+            rematchCnt++;
+        }
+        
+        // the one has fewer whites gets white, the higher ranked one when both have same preferences
+        auto iWhite = colours[i] != colours[j] ? colours[i] < colours[j] : (colours[i] > 0 ? false : (colours[i] < 0 || (std::rand() & 1)));
+        MatchRecord record(playerVec.at(i).playerId, playerVec.at(j).playerId, !iWhite);
+        record.round = round;
+        addMatchRecord(record);
+    }
+    
+    if (rematchCnt) {
+        std::cout << "Warning: " << rematchCnt << " pair(s) have played together already." << std::endl;
+    }
+    return true;
+}
+
 std::string TourMng::createLogPath(std::string opath, bool onefile, bool usesurfix, bool includeGameResult, const Game* game, Side forSide)
 {
     if (onefile || game == nullptr) return opath;
@@ -1106,8 +1514,10 @@ void TourMng::matchLog(const std::string& infoString, bool verbose)
     }
     
     if (logResultMode && !logResultPath.empty()) {
+        metrics.logQueueDepth++;
         std::lock_guard<std::mutex> dolock(matchMutex);
         append2TextFile(logResultPath, infoString);
+        metrics.logQueueDepth--;
     }
 }
 
@@ -1136,9 +1546,20 @@ void TourMng::engineLog(const Game* game, const std::string& name, const std::st
         stringStream << name;
     }
     
-    stringStream << (logType == LogType::toEngine ? "< " : "> ") << line;
+    stringStream << (logType == LogType::toEngine ? "< " : "> ");
+    auto prefix = stringStream.str();
     
-    auto str = stringStream.str();
+    // a batch of commands is written at once but logged line by line
+    std::string str;
+    if (logType == LogType::toEngine && line.find('\n') != std::string::npos) {
+        std::istringstream iss(line);
+        for(std::string s; std::getline(iss, s);) {
+            if (!str.empty()) str += "\n";
+            str += prefix + s;
+        }
+    } else {
+        str = prefix + line;
+    }
     
     if (logScreenEngineInOutMode) {
         printText(str);
@@ -1151,8 +1572,10 @@ void TourMng::engineLog(const Game* game, const std::string& name, const std::st
     auto path = createLogPath(logEnginePath, logEngineAllInOneMode, logEngineGameTitleSurfix, false, game, forSide);
     
     if (!path.empty()) {
+        metrics.logQueueDepth++;
         std::lock_guard<std::mutex> dolock(logMutex);
         append2TextFile(path, str);
+        metrics.logQueueDepth--;
     }
 }
 
@@ -1167,7 +1590,14 @@ void TourMng::append2TextFile(const std::string& path, const std::string& str)
 void TourMng::shutdown()
 {
     timer.remove(mainTimerId);
+    workerPool.stop();
+    completionQueue.stop();
+    pgnFile.close();
+    gameArchive.close();
+    trainingDataWriter.close();
     playerMng.shutdown();
+    metrics.stopServer();
+    handshakeCache.save();
 }
 
 int TourMng::uncompletedMatches()
@@ -1205,37 +1635,61 @@ void TourMng::saveMatchRecords()
     d["type"] = tourTypeNames[static_cast<int>(type)];
     d["timeControl"] = timeController.saveToJson();
     
-    Json::Value a;
-    for(auto && r : matchRecordList) {
-        a.append(r.saveToJson());
+    {
+        std::lock_guard<OwnedMutex> dolock(recordMutex);
+        Json::Value a;
+        for(auto && r : matchRecordList) {
+            a.append(r.saveToJson(playerRegistry));
+        }
+        d["recordList"] = a;
     }
-    d["recordList"] = a;
     d["elapsed"] = static_cast<int>(time(nullptr) - startTime);
     
     JsonSavable::saveToJsonFile(matchPath, d);
 }
 
+// Records are read one by one from the stream into the list, no document is built for them
 bool TourMng::loadMatchRecords(bool autoYesReply)
 {
-    Json::Value d;
-    if (!resumable || !loadFromJsonFile(matchPath, d, false)) {
+    JsonReader reader;
+    if (!resumable || !reader.open(matchPath) || !reader.beginObject()) {
         return false;
     }
     
-    auto uncompletedCnt = 0;
+    auto uncompletedCnt = 0, elapsed = 0;
     std::vector<MatchRecord> recordList;
-    auto array = d["recordList"];
-    for(int i = 0; i < int(array.size()); i++) {
-        auto v = array[i];
-        MatchRecord record;
-        if (record.load(v)) {
-            recordList.push_back(record);
-            if (record.state == MatchState::none) {
-                uncompletedCnt++;
+    std::string typeString;
+    Json::Value timeControlObj;
+    
+    for(std::string key; reader.nextMember(key);) {
+        if (key == "recordList" && reader.peek() == JsonReader::ValueType::array) {
+            reader.beginArray();
+            while (reader.nextElement()) {
+                MatchRecord record;
+                if (record.load(reader, playerRegistry)) {
+                    recordList.push_back(record);
+                    if (record.state == MatchState::none) {
+                        uncompletedCnt++;
+                    }
+                }
             }
+        } else if (key == "type" && reader.peek() == JsonReader::ValueType::string) {
+            reader.readString(typeString);
+        } else if (key == "timeControl") {
+            reader.readValue(timeControlObj);
+        } else if (key == "elapsed" && reader.peek() == JsonReader::ValueType::number) {
+            reader.readInt(elapsed);
+        } else {
+            reader.skipValue();
         }
     }
     
+    // broken files are ignored as ones which can't be opened
+    if (reader.hasError()) {
+        return false;
+    }
+    reader.close();
+    
     if (uncompletedCnt == 0) {
         removeMatchRecordFile();
         return false;
@@ -1264,30 +1718,28 @@ bool TourMng::loadMatchRecords(bool autoYesReply)
     std::cout << "Tournament resumed!" << std::endl;
     
     matchRecordList = recordList;
+    rebuildStandings();
     
     auto first = matchRecordList.front();
     
-    if (d.isMember("type")) {
-        auto s = d["type"].asString();
+    if (!typeString.empty()) {
         for(int t = 0; tourTypeNames[t]; t++) {
-            if (tourTypeNames[t] == s) {
+            if (tourTypeNames[t] == typeString) {
                 type = static_cast<TourType>(t);
             }
         }
     }
     
-    auto s = "timeControl";
-    if (d.isMember(s)) {
-        auto obj = d[s];
+    if (timeControlObj.isObject()) {
         auto oldTimeControl = timeController.saveToJson();
-        if (!timeController.load(obj) || !timeController.isValid()) {
+        if (!timeController.load(timeControlObj) || !timeController.isValid()) {
             timeController.load(oldTimeControl);
             std::cerr << "Error: TimeControl is incorrect. Reload default one." << std::endl;
         }
     }
 
     assert(timeController.isValid());
-    previousElapsed += d["elapsed"].asInt();
+    previousElapsed += elapsed;
     
     removeMatchRecordFile();
     
@@ -1295,54 +1747,74 @@ bool TourMng::loadMatchRecords(bool autoYesReply)
     return true;
 }
 
+// Called by the worker of the game: the record is marked as completed and the data
+// for the bookkeeping is collected, the rest is done by saveCompletedMatch
 void TourMng::matchCompleted(Game* game)
 {
     if (game == nullptr) return;
     
-    auto gIdx = game->getIdx();
-    if (gIdx >= 0 && gIdx < matchRecordList.size()) {
-        auto record = &matchRecordList[gIdx];
-        assert(record->state == MatchState::playing);
-        record->state = MatchState::completed;
-        record->result = game->board.result;
-        
-        EngineStats engineStats[2];
+    CompletedMatch match;
+    auto gIdx = match.gameIdx = game->getIdx();
+    
+    int round = -1;
+    std::string startFen;
+    std::vector<Move> startMoves;
+    {
+        std::lock_guard<OwnedMutex> dolock(recordMutex);
+        if (gIdx >= 0 && gIdx < matchRecordList.size()) {
+            auto record = &matchRecordList[gIdx];
+            assert(record->state == MatchState::playing);
+            record->state = MatchState::completed;
+            record->result = game->board.result;
+            round = record->round;
+            match.playerIds[W] = record->playerIds[W];
+            match.playerIds[B] = record->playerIds[B];
+            match.recorded = true;
+            if (archiveMode) {
+                startFen = record->startFen;
+                startMoves = record->startMoves;
+            }
+        }
+    }
+    
+    if (match.recorded) {
         for(auto && hist : game->board.histList) {
             // not for uncomputing moves
             if (hist.nodes == 0) {
                 continue;
             }
             auto sd = static_cast<int>(hist.move.piece.side);
-            engineStats[sd].nodes += hist.nodes;
-            engineStats[sd].depths += hist.depth;
-            engineStats[sd].elapsed += hist.elapsed;
-            engineStats[sd].moves++;
+            match.engineStats[sd].nodes += hist.nodes;
+            match.engineStats[sd].depths += hist.depth;
+            match.engineStats[sd].elapsed += hist.elapsed;
+            match.engineStats[sd].moves++;
         }
         
         for(int sd = 0; sd < 2; sd++) {
-            engineStats[sd].games++;
-            auto side = static_cast<Side>(sd);
-            auto name = game->getPlayer(side)->getName();
-            auto it = engineStatsMap.find(name);
-            if (it != engineStatsMap.end()) {
-                engineStats[sd].add(it->second);
-            }
-            engineStatsMap[name] = engineStats[sd];
-            //            std::cout << "adding, sd: " << sd << ", name: " << name << ", #n: " << game->board.histList.size()
-            //            << ", games: " << engineStats[sd].games
-            //            << ", nodes: " << engineStats[sd].nodes
-            //            << ", depths: " << engineStats[sd].depths
-            //            << ", moves: " << engineStats[sd].moves
-            //            << ", elapsed: " << engineStats[sd].elapsed
-            //            << std::endl;
+            match.engineStats[sd].games++;
         }
         
         if (pgnPathMode && !pgnPath.empty()) {
-            auto pgnString = game->toPgn(eventName, siteName, record->round, record->gameIdx, logPgnRichMode);
-            auto path = createLogPath(pgnPath, logPgnAllInOneMode, logPgnGameTitleSurfix, true, game);
-            if (!path.empty()) {
-                append2TextFile(path, pgnString);
-            }
+            // one buffer per worker, reused for all games
+            static thread_local PgnWriter pgnWriter;
+            game->toPgn(pgnWriter, eventName, siteName, round, gIdx, logPgnRichMode);
+            match.pgnString = pgnWriter.str();
+            match.pgnPath = createLogPath(pgnPath, logPgnAllInOneMode, logPgnGameTitleSurfix, true, game);
+        }
+        
+        if (archiveMode) {
+            auto& archiveGame = match.archiveGame;
+            archiveGame.gameIdx = gIdx;
+            archiveGame.round = round;
+            archiveGame.time = static_cast<i64>(std::time(nullptr));
+            archiveGame.names[W] = playerRegistry.getName(match.playerIds[W]);
+            archiveGame.names[B] = playerRegistry.getName(match.playerIds[B]);
+            archiveGame.openingKey = BookMng::getOpeningKey(startFen, startMoves);
+            archiveGame.setBoard(game->board);
+        }
+        
+        if (trainingDataMode) {
+            TrainingDataWriter::encode(game->board, match.trainingData);
         }
     }
     
@@ -1360,108 +1832,339 @@ void TourMng::matchCompleted(Game* game)
             << "\n\t" << std::setw(w) << wplayer->getName() << std::setw(0) << ": " << wplayer->profile.toString(false)
             << "\n\t" << std::setw(w) << bplayer->getName() << std::setw(0) << ": " << bplayer->profile.toString(false);
             
-            Profile profile = wplayer->profile;
-            auto it = profileMap.find(wplayer->getName());
-            if (it != profileMap.end()) {
-                profile.addFrom(it->second);
-            }
-            profileMap[wplayer->getName()] = profile;
-            
-            profile = bplayer->profile;
-            it = profileMap.find(bplayer->getName());
-            if (it != profileMap.end()) {
-                profile.addFrom(it->second);
-            }
-            profileMap[bplayer->getName()] = profile;
+            match.profiles[W] = wplayer->profile;
+            match.profiles[B] = bplayer->profile;
         }
         
-        auto infoString = stringStream.str();
-        matchLog(infoString, banksiaVerbose);
+        match.infoString = stringStream.str();
+        
+        // time between the go commands and the moves which is the manager's, not charged to engines
+        std::ostringstream overheadStream;
+        overheadStream << std::fixed << std::setprecision(1)
+        << "\toverhead: " << wplayer->getName() << " " << game->getOverhead(Side::white) * 1000 << " ms, "
+        << bplayer->getName() << " " << game->getOverhead(Side::black) * 1000 << " ms";
+        match.overheadString = overheadStream.str();
+        
         // Add extra info to help understanding log
         if (!logEngineBySides) {
-            engineLog(game, getAppName(), infoString, LogType::system);
+            engineLog(game, getAppName(), match.infoString + "\n" + match.overheadString, LogType::system);
         }
     }
     
-    checkToExtendMatches(gIdx);
-    
-    saveMatchRecords();
+    completionQueue.push([this, match]() {
+        saveCompletedMatch(match);
+    });
 }
 
-std::vector<TourPlayer> TourMng::collectStats() const
+// Called by the thread of completionQueue, one match at a time in the order of completing
+void TourMng::saveCompletedMatch(const CompletedMatch& match)
 {
-    std::map<std::string, TourPlayer> resultMap;
+    if (!match.pgnString.empty() && !match.pgnPath.empty() && !pgnFile.append(match.pgnPath, match.pgnString)) {
+        std::cerr << "Error: cannot write to the PGN file " << match.pgnPath << std::endl;
+    }
     
-    for(auto && m : matchRecordList) {
-        if (m.result.result == ResultType::noresult) { // hm ?
-            continue;
+    if (archiveMode && match.archiveGame.gameIdx >= 0) {
+        gameArchive.add(match.archiveGame);
+        
+        // the game is marked as completed in the match record file below, a resumed
+        // tournament won't play it again thus it must be on the disk before that
+        if (resumable) {
+            gameArchive.flush();
         }
+    }
+    if (trainingDataMode) {
+        trainingDataWriter.write(match.trainingData);
+    }
+    
+    if (!match.infoString.empty()) {
+        matchLog(match.infoString, banksiaVerbose);
+        matchLog(match.overheadString, false);
+    }
+    
+    {
+        std::lock_guard<OwnedMutex> dolock(recordMutex);
         
-        for(int sd = 0; sd < 2; sd++) {
-            auto name = m.playernames[sd];
-            if (name.empty()) { // bye players (in knockout) won without opponents
-                continue;
-            }
+        if (match.recorded) {
+            auto& record = matchRecordList[match.gameIdx];
+            addToStandings(record);
             
-            TourPlayer r;
-            auto it = resultMap.find(name);
-            if (it == resultMap.end()) {
-                r.name = name;
-            } else {
-                r = it->second; assert(r.name == name);
+            metrics.gameCnt++;
+            if (record.result.reason == ReasonType::timeout) {
+                metrics.timeForfeitCnt++;
+            } else if (record.result.reason == ReasonType::crash) {
+                metrics.crashCnt++;
             }
             
-            if (m.playernames[1 - sd].empty()) { // bye player
-                r.byeCnt++;
+            engineStatsList.resize(playerRegistry.size());
+            for(int sd = 0; sd < 2; sd++) {
+                auto id = match.playerIds[sd];
+                auto& engineStats = match.engineStats[sd];
+                metrics.addEngineNodes(playerRegistry.getName(id), engineStats.nodes, engineStats.elapsed);
+                engineStatsList[id].add(engineStats);
             }
             
-            auto lossCnt = r.lossCnt;
-            r.gameCnt++;
-            switch (m.result.result) {
-                case ResultType::win:
-                    if (sd == W) r.winCnt++; else r.lossCnt++;
-                    break;
-                case ResultType::draw:
-                    r.drawCnt++;
-                    break;
-                case ResultType::loss:
-                    if (sd == B) r.winCnt++; else r.lossCnt++;
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-            
-            if (lossCnt < r.lossCnt) {
-                if (m.result.reason == ReasonType::illegalmove || m.result.reason == ReasonType::crash || m.result.reason == ReasonType::timeout) {
-                    r.abnormalCnt++;
+            if (profileMode && !match.infoString.empty()) {
+                profileList.resize(playerRegistry.size());
+                for(int sd = 0; sd < 2; sd++) {
+                    profileList[match.playerIds[sd]].addFrom(match.profiles[sd]);
                 }
             }
-            resultMap[name] = r;
         }
+        
+        checkToExtendMatches(match.gameIdx);
+        checkSprt();
     }
     
-    std::vector<TourPlayer> resultList;
-    for (auto && s : resultMap) {
-        resultList.push_back(s.second);
+    saveMatchRecords();
+    
+    if (openingStats.mode) {
+        openingStats.saveFile();
     }
-    return resultList;
 }
 
-std::string TourMng::createTournamentStats()
+// Games 2k and 2k + 1 of a pair (same pairId) are played with swapped sides and counted together.
+// Pairs with an odd number of games or ones without inclusive players for both sides can't be split that way
+bool TourMng::isPentanomialMode() const
+{
+    return gameperpair >= 2 && (gameperpair & 1) == 0 && swapPairSides
+        && (!inclusivePlayerMode || inclusivePlayerSide == Side::none);
+}
+
+void TourMng::addToSprtStats(const MatchRecord& r)
+{
+    if (!sprt.mode || r.isBye()) {
+        return;
+    }
+    
+    int sd;
+    if (r.playerIds[W] == sprtPlayerId) sd = W;
+    else if (r.playerIds[B] == sprtPlayerId) sd = B;
+    else return;
+    
+    int halfPoints;
+    switch (r.result.result) {
+        case ResultType::win:
+            halfPoints = sd == W ? 2 : 0;
+            break;
+        case ResultType::draw:
+            halfPoints = 1;
+            break;
+        case ResultType::loss:
+            halfPoints = sd == B ? 2 : 0;
+            break;
+        default:
+            return;
+    }
+    
+    sprtStats.add(halfPoints, getPairKey(r));
+}
+
+// Games 2k and 2k + 1 of a pair have the same key. Extra games (tie-breaks of knockout)
+// are far from the start of their pairs, they are never counted with others
+u64 TourMng::getPairKey(const MatchRecord& r) const
+{
+    auto it = pairStartMap.find(r.pairId);
+    auto pairGameIdx = it != pairStartMap.end() ? r.gameIdx - it->second : 0;
+    return u64(u32(r.pairId)) << 32 | u32(pairGameIdx / 2);
+}
+
+double TourMng::calcSprtLLR() const
+{
+    return isPentanomialMode() ? sprt.getLLR(sprtStats.penta, 5) : sprt.getLLR(sprtStats.trino, 3);
+}
+
+void TourMng::checkSprt()
+{
+    if (!sprt.mode || sprtResult != SprtResult::none) {
+        return;
+    }
+
+    auto llr = calcSprtLLR();
+    sprtResult = sprt.check(llr);
+
+    if (sprtResult != SprtResult::none) {
+        std::ostringstream stringStream;
+        stringStream << std::fixed << std::setprecision(2)
+        << "\n* SPRT: " << Sprt::sprtResult2String(sprtResult) << " for " << sprt.playerName
+        << ", LLR: " << llr << " (" << sprt.lowerBound() << ", " << sprt.upperBound() << "). Stop the tournament!";
+        matchLog(stringStream.str(), true);
+    }
+}
+
+void TourMng::addToOpeningStats(const MatchRecord& r)
+{
+    if (!openingStats.mode || r.isBye()
+        || (r.startFen.empty() && r.startMoves.empty())) {
+        return;
+    }
+    
+    auto key = BookMng::getOpeningKey(r.startFen, r.startMoves);
+    if (openingStats.add(key, getPairKey(r), r.startFen, r.startMoves, r.result.result)) {
+        bookMng.dropOpening(key);
+        replaceDroppedOpening(key);
+        
+        std::ostringstream stringStream;
+        stringStream << "* Opening dropped (all pairs have the same results): " << (r.startFen.empty() ? "" : r.startFen + " ");
+        for(auto && move : r.startMoves) {
+            stringStream << move.toCoordinateString() << " ";
+        }
+        matchLog(stringStream.str(), banksiaVerbose);
+    }
+}
+
+// Matches which have not started yet get new openings, same ones for a pair.
+// Pairs with a started game keep the opening thus they are still fair
+void TourMng::replaceDroppedOpening(u64 key)
+{
+    std::set<int> startedPairIds;
+    std::vector<MatchRecord*> recordVec;
+    for(auto && r : matchRecordList) {
+        if ((r.startFen.empty() && r.startMoves.empty())
+            || BookMng::getOpeningKey(r.startFen, r.startMoves) != key) {
+            continue;
+        }
+        if (r.state == MatchState::none) {
+            recordVec.push_back(&r);
+        } else {
+            startedPairIds.insert(r.pairId);
+        }
+    }
+    
+    std::unordered_map<int, const MatchRecord*> pairMap;
+    for(auto && r : recordVec) {
+        if (startedPairIds.find(r->pairId) != startedPairIds.end()) {
+            continue;
+        }
+        auto it = pairMap.find(r->pairId);
+        if (it != pairMap.end()) {
+            r->startFen = it->second->startFen;
+            r->startMoves = it->second->startMoves;
+            continue;
+        }
+        
+        std::string fenString;
+        std::vector<Move> moves;
+        if (bookMng.getNewRandomBook(fenString, moves)) {
+            r->startFen = fenString;
+            r->startMoves = moves;
+            pairMap[r->pairId] = r;
+        }
+    }
+}
+
+std::vector<TourPlayer> TourMng::collectStats() const
+{
+    assert(recordMutex.isOwned());
+    return standingList;
+}
+
+TourPlayer& TourMng::getStanding(int playerId)
+{
+    if (playerId >= int(standingIdxList.size())) {
+        standingIdxList.resize(playerId + 1, -1);
+    }
+    auto& idx = standingIdxList[playerId];
+    if (idx >= 0) {
+        return standingList[idx];
+    }
+    
+    idx = int(standingList.size());
+    TourPlayer r;
+    r.playerId = playerId;
+    standingList.push_back(r);
+    return standingList.back();
+}
+
+void TourMng::addToStandings(const MatchRecord& m)
+{
+    if (m.state != MatchState::completed || m.result.result == ResultType::noresult) { // hm ?
+        return;
+    }
+    
+    for(int sd = 0; sd < 2; sd++) {
+        auto id = m.playerIds[sd];
+        if (id < 0) { // bye players (in knockout) won without opponents
+            continue;
+        }
+        
+        auto& r = getStanding(id); assert(r.playerId == id);
+        
+        if (m.playerIds[1 - sd] < 0) { // bye player
+            r.byeCnt++;
+        } else if (sd == W) {
+            r.whiteCnt++;
+        }
+        
+        auto lossCnt = r.lossCnt;
+        r.gameCnt++;
+        switch (m.result.result) {
+            case ResultType::win:
+                if (sd == W) r.winCnt++; else r.lossCnt++;
+                break;
+            case ResultType::draw:
+                r.drawCnt++;
+                break;
+            case ResultType::loss:
+                if (sd == B) r.winCnt++; else r.lossCnt++;
+                break;
+            default:
+                assert(false);
+                break;
+        }
+        
+        if (lossCnt < r.lossCnt) {
+            if (m.result.reason == ReasonType::illegalmove || m.result.reason == ReasonType::crash || m.result.reason == ReasonType::timeout) {
+                r.abnormalCnt++;
+            }
+        }
+    }
+    
+    addToSprtStats(m);
+    addToOpeningStats(m);
+}
+
+void TourMng::rebuildStandings()
 {
+    standingList.clear();
+    standingIdxList.clear();
     
+    sprtStats.clear();
+    openingStats.clear();
+    
+    pairStartMap.clear();
+    nextPairId = 0;
+    for(auto && m : matchRecordList) {
+        if (pairStartMap.emplace(m.pairId, m.gameIdx).second) {
+            nextPairId = std::max(nextPairId, m.pairId + 1);
+        }
+        addToStandings(m);
+    }
+}
+
+std::string TourMng::createTournamentStats()
+{
+    // standings and stats are changed by the thread of the completion queue
+    std::lock_guard<OwnedMutex> dolock(recordMutex);
+    return createTournamentStats_straight();
+}
+
+std::string TourMng::createTournamentStats_straight()
+{
+    assert(recordMutex.isOwned());
     auto resultList = collectStats();
     
     auto maxNameLen = 0, abnormalCnt = 0;
     for (auto && r : resultList) {
-        maxNameLen = std::max(maxNameLen, int(r.name.length()));
+        maxNameLen = std::max(maxNameLen, int(playerRegistry.getName(r.playerId).length()));
         abnormalCnt += r.abnormalCnt;
     }
     
-    std::sort(resultList.begin(), resultList.end(), [](const TourPlayer& lhs, const TourPlayer& rhs)
+    // tied players are ordered by names, the same on every run or resume
+    std::sort(resultList.begin(), resultList.end(), [&](const TourPlayer& lhs, const TourPlayer& rhs)
               {
-                  return rhs.smaller(lhs); // return lhs.smaller(rhs);
+                  if (rhs.smaller(lhs)) return true;
+                  if (lhs.smaller(rhs)) return false;
+                  return playerRegistry.getName(lhs.playerId) < playerRegistry.getName(rhs.playerId);
               });
     
     
@@ -1493,7 +2196,7 @@ std::string TourMng::createTournamentStats()
         
         stringStream
         << std::right << std::setw(3) << (i + 1) << ". "
-        << std::left << std::setw(maxNameLen + 2) << r.name
+        << std::left << std::setw(maxNameLen + 2) << playerRegistry.getName(r.playerId)
         << std::right << std::setw(5) << r.gameCnt
         //        << std::fixed << std::setprecision(1)
         << std::right << std::setw(w) << win // << std::left << std::setw(0) << "%"
@@ -1514,8 +2217,8 @@ std::string TourMng::createTournamentStats()
     stringStream << std::endl << "\nTech (average nodes, depths, time/m per move, others per game):\n";
     
     EngineStats allStats;
-    for(auto && s : engineStatsMap) {
-        allStats.add(s.second);
+    for(auto && s : engineStatsList) {
+        allStats.add(s);
     }
     
     stringStream
@@ -1547,7 +2250,7 @@ std::string TourMng::createTournamentStats()
     
     for(int i = 0; i < resultList.size(); i++) {
         auto r = resultList.at(i);
-        auto stats = engineStatsMap[r.name];
+        auto stats = r.playerId < int(engineStatsList.size()) ? engineStatsList[r.playerId] : EngineStats();
         
         auto games = std::max<i64>(1, stats.games);
         auto moves = std::max<i64>(1, stats.moves);
@@ -1555,7 +2258,7 @@ std::string TourMng::createTournamentStats()
         
         stringStream
         << std::right << std::setw(3) << (i + 1) << ". "
-        << std::left << std::setw(maxNameLen + 2) << r.name
+        << std::left << std::setw(maxNameLen + 2) << playerRegistry.getName(r.playerId)
         << std::right << std::setw(w) << nodeStr
         << std::right << std::setw(w) << double(stats.depths) / moves
         << std::right << std::setw(w) << stats.elapsed / double(std::max<i64>(1, stats.moves))
@@ -1573,9 +2276,8 @@ std::string TourMng::createTournamentStats()
         }
         
         if (profileMode) {
-            auto it = profileMap.find(r.name);
-            if (it != profileMap.end()) {
-                stringStream << std::left << std::setw(0) << it->second.toString(true);
+            if (r.playerId < int(profileList.size()) && !profileList[r.playerId].isEmpty()) {
+                stringStream << std::left << std::setw(0) << profileList[r.playerId].toString(true);
             }
         }
         stringStream << std::endl;
@@ -1600,8 +2302,8 @@ std::string TourMng::createTournamentStats()
     
     if (profileMode) {
         Profile profile;
-        for (auto && p : profileMap) {
-            profile.addFrom(p.second);
+        for (auto && p : profileList) {
+            profile.addFrom(p);
         }
         
         stringStream << std::left << std::setw(0) << profile.toString(true);
@@ -1612,7 +2314,33 @@ std::string TourMng::createTournamentStats()
     if (abnormalCnt) {
         stringStream << "Failed games (timeout, crashed, illegal moves): " << abnormalCnt << " of " << matchRecordList.size();
     }
-    
+
+    if (metrics.moveLatency.count()) {
+        stringStream << "\nManager latency (move read -> opponent go written), " << metrics.moveLatency.toString();
+    }
+
+    if (openingStats.mode) {
+        stringStream << "\nOpening stats, " << openingStats.toString() << std::endl;
+    }
+
+    if (sprt.mode) {
+        auto llr = calcSprtLLR();
+        auto penta = sprtStats.penta, trino = sprtStats.trino;
+
+        stringStream << std::setprecision(2)
+        << "\nSPRT for " << sprt.playerName << " (" << sprt.toString() << "): LLR " << llr
+        << " (" << sprt.lowerBound() << ", " << sprt.upperBound() << ")";
+        if (sprtResult != SprtResult::none) {
+            stringStream << ", " << Sprt::sprtResult2String(sprtResult);
+        }
+        if (isPentanomialMode()) {
+            stringStream << ", pentanomial: " << penta[0] << ", " << penta[1] << ", " << penta[2] << ", " << penta[3] << ", " << penta[4];
+        } else {
+            stringStream << ", trinomial (L, D, W): " << trino[0] << ", " << trino[1] << ", " << trino[2];
+        }
+        stringStream << std::endl;
+    }
+
     return stringStream.str();
 }
 
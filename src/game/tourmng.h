@@ -31,6 +31,13 @@
 #include "uciengine.h"
 #include "playermng.h"
 #include "book.h"
+#include "openingstats.h"
+#include "workerpool.h"
+#include "completionqueue.h"
+#include "pgnwriter.h"
+#include "gamearchive.h"
+#include "trainingdata.h"
+#include "jsonreader.h"
 
 #include "../3rdparty/cpptime/cpptime.h"
 
@@ -39,6 +46,23 @@ namespace banksia {
         roundrobin, knockout, swiss, none
     };
     
+    // Players are registered with dense ids when the tournament is loaded,
+    // all tournament data refer them by ids, names are for input/output only
+    class PlayerRegistry {
+    public:
+        void clear();
+        int add(const std::string& name);
+        int find(const std::string& name) const;
+        const std::string& getName(int id) const;
+        int size() const {
+            return int(nameList.size());
+        }
+        
+    private:
+        std::vector<std::string> nameList;
+        std::unordered_map<std::string, int> idMap;
+    };
+    
     class EngineStats {
     public:
         i64 nodes = 0, depths = 0, moves = 0, games = 0;
@@ -49,34 +73,54 @@ namespace banksia {
         }
     };
     
+    // What is kept from a completed game for the bookkeeping (standings, stats, PGN, logs),
+    // the game itself is deleted right after
+    class CompletedMatch {
+    public:
+        int gameIdx = -1;
+        bool recorded = false;
+        int playerIds[2] = { -1, -1 };
+        EngineStats engineStats[2];
+        Profile profiles[2];
+        std::string pgnPath, pgnString, infoString, overheadString;
+        ArchiveGame archiveGame; // gameIdx is -1 if the game is not archived
+        std::string trainingData; // records of TrainingDataWriter
+    };
+    
     enum class MatchState {
         none, playing, completed, error
     };
     
-    class MatchRecord : public Jsonable
+    // Players are stored by ids of a PlayerRegistry, -1 for the missing one of bye records
+    class MatchRecord : public Obj
     {
     public:
         MatchRecord() {}
-        MatchRecord(const std::string& name0, const std::string& name1, bool swap) {
+        MatchRecord(int playerId0, int playerId1, bool swap) {
             auto sd = swap ? B : W;
-            playernames[sd] = name0; playernames[1 - sd] = name1;
+            playerIds[sd] = playerId0; playerIds[1 - sd] = playerId1;
         }
         virtual ~MatchRecord() {}
         virtual const char* className() const override { return "MatchRecord"; }
         virtual bool isValid() const override;
         virtual std::string toString() const override;
         
-        virtual bool load(const Json::Value& obj) override;
-        virtual Json::Value saveToJson() const override;
+        // the object is read from the stream, playing.json could have a lot of records
+        bool load(JsonReader& reader, PlayerRegistry& registry);
+        Json::Value saveToJson(const PlayerRegistry& registry) const;
 
         void swapPlayers() {
-            std::swap(playernames[0], playernames[1]);
+            std::swap(playerIds[0], playerIds[1]);
+        }
+        
+        bool isBye() const {
+            return playerIds[0] < 0 || playerIds[1] < 0;
         }
         
     public:
         MatchState state = MatchState::none;
         
-        std::string playernames[2];
+        int playerIds[2] = { -1, -1 };
         
         std::string startFen;
         std::vector<Move> startMoves;
@@ -94,7 +138,7 @@ namespace banksia {
     public:
         virtual ~TourPlayer() {}
 
-        std::string name;
+        int playerId = -1;
         int gameCnt = 0, winCnt = 0, drawCnt = 0, lossCnt = 0, abnormalCnt = 0, elo = 0, flag = 0;
         int byeCnt = 0, whiteCnt = 0; // for swiss and knockdown
         virtual const char* className() const override { return "TourPlayer"; }
@@ -117,6 +161,71 @@ namespace banksia {
         double elo_difference, los;
     };
     
+    enum class SprtResult {
+        none, h0, h1
+    };
+    
+    // Sequential probability ratio test (GSPRT, normal approximation, logistic elo)
+    class Sprt : public Jsonable {
+    public:
+        virtual ~Sprt() {}
+        virtual const char* className() const override { return "Sprt"; }
+        virtual bool isValid() const override;
+        virtual std::string toString() const override;
+        
+        virtual bool load(const Json::Value& obj) override;
+        virtual Json::Value saveToJson() const override;
+        
+        // counts of n buckets, bucket k scores k / (n - 1): n = 3 for trinomial, 5 for pentanomial
+        double getLLR(const i64* counts, int n) const;
+        double lowerBound() const;
+        double upperBound() const;
+        SprtResult check(double llr) const;
+        
+        static double elo2Score(double elo);
+        static std::string sprtResult2String(SprtResult result);
+
+    public:
+        bool mode = false;
+        std::string playerName;
+        double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+    };
+    
+    // Results of the tested player, counted by games (trinomial) and by pairs of games (pentanomial)
+    class SprtStats {
+    public:
+        void clear();
+        
+        // halfPoints: 0 for a loss, 1 for a draw, 2 for a win; games of a pair have the same pairKey
+        void add(int halfPoints, u64 pairKey);
+        
+    public:
+        i64 penta[5] = { 0, 0, 0, 0, 0 }, trino[3] = { 0, 0, 0 }; // buckets from losses to wins
+        
+    private:
+        std::unordered_map<u64, std::pair<int, int>> pairMap; // pairKey -> number of games, half points
+    };
+    
+    // A mutex which knows the thread holding it, thus functions can assert their callers hold it
+    class OwnedMutex {
+    public:
+        void lock() {
+            mutex.lock();
+            owner = std::this_thread::get_id();
+        }
+        void unlock() {
+            owner = std::thread::id();
+            mutex.unlock();
+        }
+        bool isOwned() const {
+            return owner == std::this_thread::get_id();
+        }
+        
+    private:
+        std::mutex mutex;
+        std::atomic<std::thread::id> owner { std::thread::id() };
+    };
+    
     class TourMng : public Obj, public Tickable, public JsonSavable
     {
     public:
@@ -127,9 +236,9 @@ namespace banksia {
         virtual const char* className() const override { return "TourMng"; }
         
         bool createMatchList();
-        bool createMatchList(std::vector<std::string> nameList, TourType type);
+        bool createMatchList(std::vector<int> playerIdList, TourType type);
         void createMatch(MatchRecord&);
-        bool createMatch(int gameIdx, const std::string& whiteName, const std::string& blackName, const std::string& startFen, const std::vector<Move>& startMoves);
+        bool createMatch(int gameIdx, int whiteId, int blackId, const std::string& startFen, const std::vector<Move>& startMoves);
         
         bool start(const std::string& mainJsonPath, bool yesReply, bool noReply);
         
@@ -139,6 +248,7 @@ namespace banksia {
         void setEngineLogMode(bool enabled);
         void setEngineLogPath(const std::string&);
         
+        // it takes recordMutex, called from the console thread while games are playing
         std::string createTournamentStats();
         
         void showEgineInOutToScreen(bool enabled);
@@ -150,7 +260,10 @@ namespace banksia {
 
     protected:
         void startTournament();
+        // a copy of the standings, the caller holds recordMutex (the thread of the
+        // completion queue changes them)
         std::vector<TourPlayer> collectStats() const;
+        std::string createTournamentStats_straight(); // the caller holds recordMutex
         
         void reset();
         
@@ -169,9 +282,10 @@ namespace banksia {
         
 
         // for all
-        bool pairingMatchList(const std::vector<std::string>& nameList);
+        bool pairingMatchList(const std::vector<int>& playerIdList);
         bool pairingMatchList(std::vector<TourPlayer> playerVec, int round);
-        bool pairingMatchListRecusive(std::vector<TourPlayer>& playerVec, int round, const std::set<std::string>& pairedSet);
+        bool pairingByMatching(const std::vector<TourPlayer>& playerVec, int round);
+        void addByeRecord(int playerId, int round);
 
         // Knockout
         std::vector<TourPlayer> getKnockoutWinnerList();
@@ -180,11 +294,30 @@ namespace banksia {
         // Swiss
         bool createNextSwisstMatchList();
 
+        // Standings, updated incrementally when matches completed
+        void addToStandings(const MatchRecord& record);
+        void rebuildStandings();
+        TourPlayer& getStanding(int playerId);
+
+        // SPRT
+        bool isPentanomialMode() const;
+        u64 getPairKey(const MatchRecord& record) const;
+        void addToSprtStats(const MatchRecord& record);
+        double calcSprtLLR() const;
+        void checkSprt();
+
+        // Opening stats
+        void addToOpeningStats(const MatchRecord& record);
+        void replaceDroppedOpening(u64 key);
+
         //
         void matchCompleted(Game* game);
+        void saveCompletedMatch(const CompletedMatch& match);
         bool addGame(Game* game);
+        bool startMatches();
         
         void tickWork() override;
+        void tickGame(Game* game);
         
         void matchLog(const std::string& line, bool verbose);
         int uncompletedMatches();
@@ -201,7 +334,8 @@ namespace banksia {
         TimeController timeController;
         bool shufflePlayers = false;
 
-        std::vector<std::string> participantList;
+        PlayerRegistry playerRegistry; // filled when loading, read-only while playing
+        std::vector<int> participantList;
         std::vector<MatchRecord> matchRecordList;
         std::vector<Game*> gameList;
         PlayerMng playerMng;
@@ -221,8 +355,9 @@ namespace banksia {
 
         static void showPathInfo(const std::string& name, const std::string& path, bool mode);
         
-        std::map<std::string, Profile> profileMap;
-        std::map<std::string, EngineStats> engineStatsMap;
+        // indexed by player ids
+        std::vector<Profile> profileList;
+        std::vector<EngineStats> engineStatsList;
 
     private:
         
@@ -230,19 +365,49 @@ namespace banksia {
         std::string syzygyPath;
         
         GameConfig gameConfig;
+        
+        // standings: player ids -> indexes of standingList (-1 if the player has no game yet)
+        std::vector<TourPlayer> standingList;
+        std::vector<int> standingIdxList;
+
+        Sprt sprt;
+        int sprtPlayerId = -1;
+        SprtResult sprtResult = SprtResult::none;
+        SprtStats sprtStats;
+        
+        // games of a pair have the same pairId, counted from zero
+        int nextPairId = 0;
+        std::unordered_map<int, int> pairStartMap; // pairId -> gameIdx of the first game of the pair
+
+        OpeningStats openingStats;
+
+        bool metricsMode = false;
+        int metricsPort = 9100;
 
         // inclusive players
         bool inclusivePlayerMode = false;
-        std::set<std::string> inclusivePlayers;
+        std::vector<bool> inclusivePlayers; // indexed by player ids
         Side inclusivePlayerSide = Side::none;
         
         int previousElapsed = 0;
         time_t startTime;
         
+        // games are ticked by workers, one task per game at a time. recordMutex guards
+        // match records, standings and stats
+        WorkerPool workerPool;
+        OwnedMutex recordMutex;
+        
+        // completed games are pushed by workers, the bookkeeping is done by its own thread
+        CompletionQueue completionQueue;
+        PgnFile pgnFile; // used by the thread of completionQueue only
+        GameArchive gameArchive; // the same
+        TrainingDataWriter trainingDataWriter; // the same
+        
         // for logging
         std::mutex matchMutex, logMutex;
 
-        std::string pgnPath;
+        std::string pgnPath, archivePath, trainingDataPath;
+        bool archiveMode = false, trainingDataMode = false;
         bool pgnPathMode = true, logPgnAllInOneMode = false;
         bool logPgnRichMode = false, logPgnGameTitleSurfix = false;
         
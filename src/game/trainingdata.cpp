@@ -0,0 +1,103 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <iostream>
+#include <algorithm>
+
+#include "trainingdata.h"
+
+using namespace banksia;
+
+TrainingDataWriter::~TrainingDataWriter()
+{
+    close();
+}
+
+int TrainingDataWriter::encode(const ChessBoard& board, std::string& out)
+{
+    if (board.result.result == ResultType::noresult || board.result.result > ResultType::loss) {
+        return 0;
+    }
+    
+    // from white's view
+    auto whiteResult = board.result.result == ResultType::win ? 1 : board.result.result == ResultType::loss ? -1 : 0;
+    
+    ChessBoard b;
+    b.newGame(board.fromOriginPosition() ? "" : board.getStartingFen());
+    
+    auto cnt = 0;
+    PackedPosition packed;
+    for(size_t ply = 0; ply < board.histList.size(); ply++) {
+        auto& hist = board.histList[ply];
+        if (hist.depth > 0 && b.side == hist.move.piece.side) {
+            b.toPacked(packed);
+            out.append(reinterpret_cast<const char*>(packed.pieces), sizeof(packed.pieces));
+            out += static_cast<char>(packed.flags);
+            out += static_cast<char>(packed.enpassant);
+            
+            auto score = static_cast<int16_t>(std::max(-32000, std::min(32000, hist.score)));
+            auto p = static_cast<u16>(std::min<size_t>(ply, 0xffff));
+            out += static_cast<char>(score & 0xff);
+            out += static_cast<char>((score >> 8) & 0xff);
+            out += static_cast<char>(p & 0xff);
+            out += static_cast<char>(p >> 8);
+            out += static_cast<char>(b.side == Side::white ? whiteResult : -whiteResult);
+            out += static_cast<char>(std::min(hist.depth, 255));
+            cnt++;
+        }
+        
+        if (!b.checkMake(hist.move.from, hist.move.dest, hist.move.promotion)) {
+            break;
+        }
+    }
+    return cnt;
+}
+
+bool TrainingDataWriter::open(const std::string& path)
+{
+    close();
+    file = fopen(path.c_str(), "ab");
+    if (file == nullptr) {
+        std::cerr << "Error: cannot open the training data file " << path << std::endl;
+        return false;
+    }
+    buffer.resize(1024 * 1024);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    return true;
+}
+
+void TrainingDataWriter::write(const std::string& data)
+{
+    if (file && !data.empty()) {
+        fwrite(data.c_str(), 1, data.size(), file);
+    }
+}
+
+void TrainingDataWriter::close()
+{
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
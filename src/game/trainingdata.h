@@ -0,0 +1,64 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef trainingdata_h
+#define trainingdata_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../chess/chess.h"
+
+namespace banksia {
+    
+    // Positions of played games with evaluations of engines, for training (such as NNUE).
+    // Only positions whose moves were computed by engines (depth > 0) are written.
+    // A record has 40 bytes (little-endian):
+    //   34 bytes: PackedPosition (32 bytes of square nibbles, flags, en passant square)
+    //   i16 score (centipawns, side to move), u16 ply, i8 result (side to move: 1 win, 0 draw, -1 loss),
+    //   u8 depth
+    class TrainingDataWriter
+    {
+    public:
+        static const int recordSize = 40;
+        
+        ~TrainingDataWriter();
+        
+        // encode all positions of a completed game, returns the number of records
+        static int encode(const ChessBoard& board, std::string& out);
+        
+        bool open(const std::string& path);
+        void write(const std::string& data);
+        void close();
+        
+    private:
+        FILE* file = nullptr;
+        std::vector<char> buffer;
+    };
+    
+} // namespace banksia
+
+#endif /* trainingdata_h */
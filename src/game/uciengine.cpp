@@ -51,22 +51,46 @@ std::string UciEngine::protocolString() const
     return "uci";
 }
 
-bool UciEngine::sendOptions()
+// prepared ones of the config snapshot if they were merged with the same handshake
+std::vector<std::string> UciEngine::optionCommands()
 {
-    for(auto && option : config.optionList) {
-        if (!isWritable()) {
-            return false;
-        }
+    if (handshakeHit && config->optionCommandsPrepared
+        && config->optionHandshakeModified == handshake.modified && config->optionHandshakeSize == handshake.size) {
+        return config->optionCommandList;
+    }
+    return ConfigMng::instance->createOptionCommands(*config, handshake.optionList);
+}
 
-        auto o = ConfigMng::instance->checkOverrideOption(option);
-        if (o.isDefaultValue()) {
-            continue;
+// all options and the ping after them are sent as one write
+bool UciEngine::sendOptionsAndPing()
+{
+    if (!isWritable()) {
+        return false;
+    }
+    
+    auto cmds = optionCommands();
+    cmds.push_back("isready");
+    return write(cmds);
+}
+
+// With a cached handshake, options are known thus they are sent right after "uci",
+// without waiting for the engine to list them
+bool UciEngine::sendProtocol()
+{
+    if (!findHandshake()) {
+        return Engine::sendProtocol();
+    }
+    
+    for(auto && option : handshake.optionList) {
+        if (option.name == "Ponder" && !config->getOption(option.name)) {
+            ponderable = true;
         }
-        
-        std::string str = "setoption name " + o.name + " value " + o.getValueAsString();
-        write(str);
     }
-    return true;
+    
+    auto cmds = optionCommands();
+    cmds.insert(cmds.begin(), protocolString());
+    cmds.push_back("isready");
+    return write(cmds);
 }
 
 void UciEngine::newGame()
@@ -75,6 +99,8 @@ void UciEngine::newGame()
     ponderingMove = MoveFull::illegalMove;
     expectingBestmove = false;
     computingState = EngineComputingState::idle;
+    positionString.clear();
+    positionMoveCnt = 0;
     if (write("ucinewgame")) {
         setState(PlayerState::playing);
     }
@@ -103,15 +129,15 @@ bool UciEngine::goPonder(const Move& pondermove)
     Engine::go(); // just for setting flags
     ponderingMove = MoveFull::illegalMove;
     
-    if (config.ponderable && pondermove.isValid()) {
+    if (ponderable && pondermove.isValid()) {
         ponderingMove = pondermove;
         
         expectingBestmove = true;
         computingState = EngineComputingState::pondering;
 
-        auto goString = getGoString(pondermove);
-        assert(goString.find("ponder") != std::string::npos);
-        return write(goString);
+        auto goCmds = getGoCommands(pondermove);
+        assert(goCmds.back().find("ponder") != std::string::npos);
+        return write(goCmds);
     }
     return false;
 }
@@ -126,7 +152,9 @@ bool UciEngine::go()
         assert(expectingBestmove);
         if (!board->histList.empty() && board->histList.back().move == ponderingMove) {
             computingState = EngineComputingState::thinking;
-            write("ponderhit");
+            if (write("ponderhit")) {
+                goWritten();
+            }
             return true;
         }
         return stop();
@@ -135,41 +163,81 @@ bool UciEngine::go()
     assert(!expectingBestmove && computingState == EngineComputingState::idle);
     expectingBestmove = true;
     computingState = EngineComputingState::thinking;
-    auto goString = getGoString(MoveFull::illegalMove);
-    return write(goString);
+    if (!write(getGoCommands(MoveFull::illegalMove))) {
+        return false;
+    }
+    goWritten();
+    return true;
 }
 
-std::string UciEngine::getPositionString(const Move& pondermove) const
+std::string UciEngine::getPositionString(const Move& pondermove)
 {
     assert(board);
     
-    std::string str = "position " + (board->fromOriginPosition() ? "startpos" : ("fen " + board->getStartingFen()));
+    auto n = int(board->histList.size());
     
-    if (!board->histList.empty()) {
-        str += " moves";
-        for(auto && hist : board->histList) {
-            str += " " + hist.move.toCoordinateString();
+    // some engines could take the current board instead of the long list of moves
+    if (config->positionFenPly > 0 && n >= config->positionFenPly) {
+        // counters of the starting position, the origin one or a FEN which may be taken from the middle of a game
+        auto startHalfMoveCnt = 0, startFullMoveCnt = 1;
+        if (!board->fromOriginPosition()) {
+            auto vec = splitString(board->getStartingFen(), ' ');
+            if (vec.size() >= 6) {
+                startHalfMoveCnt = std::max(0, std::atoi(vec.at(4).c_str()));
+                startFullMoveCnt = std::max(1, std::atoi(vec.at(5).c_str()));
+            }
+        }
+        
+        auto halfMoveCnt = 0; // since the last capture or pawn move
+        auto i = n - 1;
+        for(; i >= 0; i--, halfMoveCnt++) {
+            auto& hist = board->histList[i];
+            if (!hist.cap.isEmpty() || hist.move.piece.type == PieceType::pawn) {
+                break;
+            }
+        }
+        if (i < 0) { // none in the history
+            halfMoveCnt += startHalfMoveCnt;
+        }
+        auto startSide = board->histList.front().move.piece.side;
+        auto fullMoveCnt = (n + (startSide == Side::black ? 1 : 0)) / 2 + startFullMoveCnt;
+        auto str = "position fen " + board->getFen(halfMoveCnt, fullMoveCnt);
+        if (pondermove.isValid()) {
+            str += " moves " + pondermove.toCoordinateString();
         }
+        return str;
     }
     
-    if (pondermove.isValid()) {
-        if (board->histList.empty()) {
-            str += " moves";
+    // cached from previous moves of the same game, only new moves are appended
+    if (positionString.empty() || positionMoveCnt > n) {
+        positionString = "position " + (board->fromOriginPosition() ? "startpos" : ("fen " + board->getStartingFen()));
+        positionString.reserve(positionString.size() + 6 + 5 * std::max(n, 200));
+        positionMoveCnt = 0;
+    }
+    
+    for(; positionMoveCnt < n; positionMoveCnt++) {
+        if (positionMoveCnt == 0) {
+            positionString += " moves";
         }
-        str += " " + pondermove.toCoordinateString();
+        positionString += ' ';
+        positionString += board->histList[positionMoveCnt].move.toCoordinateString();
     }
-    return str;
+    
+    if (pondermove.isValid()) {
+        return positionString + (n == 0 ? " moves " : " ") + pondermove.toCoordinateString();
+    }
+    return positionString;
 }
 
-std::string UciEngine::getGoString(const Move& pondermove)
+std::vector<std::string> UciEngine::getGoCommands(const Move& pondermove)
 {
-    std::string str = getPositionString(pondermove) + "\ngo ";
+    std::string str = "go ";
     if (pondermove.isValid()) {
         str += "ponder ";
     }
     
     str += timeControlString();
-    return str;
+    return { getPositionString(pondermove), str };
 }
 
 std::string UciEngine::timeControlString() const
@@ -231,7 +299,7 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
     auto cmd = static_cast<UciEngineCmd>(cmdInt);
     switch (cmd) {
         case UciEngineCmd::option:
-            if (!parseOption(line)) {
+            if (!handshakeHit && !parseOption(line)) {
                 write("Unknown option " + line);
             }
             break;
@@ -257,7 +325,7 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
             auto oldComputingState = computingState;
             computingState = EngineComputingState::idle;
             
-            auto period = timeCtrl->moveTimeConsumed(); // moveTimeConsumed();
+            auto period = moveTimeConsumed(timeCtrl);
             
             auto vec = splitString(line, ' ');
             if (vec.size() < 2) {
@@ -283,8 +351,10 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
         {
             setState(PlayerState::ready);
             expectingBestmove = false;
-            sendOptions();
-            sendPing();
+            if (!handshakeHit) {
+                saveHandshake();
+                sendOptionsAndPing();
+            }
             break;
         }
 
@@ -302,7 +372,7 @@ void UciEngine::parseLine(int cmdInt, const std::string& cmdString, const std::s
             }
             
             if (vec.at(1) == "name") { // name or author
-                config.idName = str;
+                handshake.idName = str;
             }
             break;
         }
@@ -327,7 +397,7 @@ bool UciEngine::parseOption(const std::string& s)
             
             if (type == "button") {
                 option.type = OptionType::button;
-                config.updateOption(option);
+                addEngineOption(option);
                 return true;
             }
             
@@ -352,7 +422,7 @@ bool UciEngine::parseOption(const std::string& s)
                     option.setDefaultValue(str);
                 }
                 if (option.isValid()) {
-                    config.updateOption(option);
+                    addEngineOption(option);
                     return true;
                 }
                 return false;
@@ -373,7 +443,7 @@ bool UciEngine::parseOption(const std::string& s)
                     option.type = OptionType::spin;
                     option.setDefaultValue(dInt, minInt, maxInt);
                     if (option.isValid()) {
-                        config.updateOption(option);
+                        addEngineOption(option);
                         return true;
                     }
                 }
@@ -407,7 +477,7 @@ bool UciEngine::parseOption(const std::string& s)
                         option.setDefaultValue(defaultString, list);
                         
                         if (option.isValid()) {
-                            config.updateOption(option);
+                            addEngineOption(option);
                             return true;
                         }
                         
@@ -42,7 +42,7 @@ namespace banksia {
         
     public:
         UciEngine() : EngineProfile() {}
-        UciEngine(const Config& config) : EngineProfile(config) {}
+        UciEngine(const ConfigPtr& config) : EngineProfile(config) {}
         virtual ~UciEngine() {}
         
         virtual const char* className() const override { return "UciEngine"; }
@@ -65,10 +65,12 @@ namespace banksia {
         virtual const std::unordered_map<std::string, int>& getEngineCmdMap() const override;
         virtual void parseLine(int, const std::string&, const std::string&) override;
         
-        std::string getPositionString(const Move& ponderMove) const;
-        std::string getGoString(const Move& pondermove);
+        std::string getPositionString(const Move& ponderMove);
+        std::vector<std::string> getGoCommands(const Move& pondermove);
         
-        virtual bool sendOptions();
+        virtual bool sendOptionsAndPing();
+        virtual bool sendProtocol() override;
+        std::vector<std::string> optionCommands();
         
     private:
         std::string timeControlString() const;
@@ -77,6 +79,10 @@ namespace banksia {
         
         bool expectingBestmove = false;
         Move ponderingMove;
+        
+        // position command of the current game, moves are appended when needed
+        std::string positionString;
+        int positionMoveCnt = 0;
         static const std::unordered_map<std::string, int> uciEngineCmd;
     };
     
@@ -67,9 +67,9 @@ bool WbEngine::sendOptions()
 
 bool WbEngine::candoSyncTaskNow(SyncTask task)
 {
-    if (feature_ping && expectingPongCnt) {
+    if (feature_ping && isFenced()) {
         std::lock_guard<std::mutex> dolock(syncMutex);
-        if (expectingPongCnt) {
+        if (isFenced()) {
             syncTasks.push_back(task);
             return false;
         }
@@ -80,13 +80,9 @@ bool WbEngine::candoSyncTaskNow(SyncTask task)
 bool WbEngine::doSyncTask()
 {
     assert(feature_ping);
-    if (expectingPongCnt || syncTasks.empty()) {
-        return false;
-    }
-    
     std::lock_guard<std::mutex> dolock(syncMutex);
     
-    if (expectingPongCnt || syncTasks.empty()) {
+    if (isFenced() || syncTasks.empty()) {
         return false;
     }
 
@@ -119,37 +115,36 @@ void WbEngine::newGame_straight()
     assert(getState() == PlayerState::ready);
     computingState = EngineComputingState::idle;
     
-    sendMemoryAndCoreOptions();
-    
-    write(ponderMode ? "hard" : "easy");
-    write("post");
+    // the whole setup goes to the engine as one write
+    std::vector<std::string> cmds;
+    cmds.push_back(memoryAndCoreOptionString());
+    cmds.push_back(ponderMode ? "hard" : "easy");
+    cmds.push_back("post");
 
     if (isFeatureOn("reuse", true)) {
-        write("new");
+        cmds.push_back("new");
     }
     
     if (!board->fromOriginPosition()) {
-        write("setboard " + board->getStartingFen());
+        cmds.push_back("setboard " + board->getStartingFen());
     }
     
     if (!board->histList.empty()) {
         // TODO: check logic again. No ping here
         // force to avoid some engines such as Crafty auto computing
-        write("force");
+        cmds.push_back("force");
         for (auto && hist : board->histList) {
-            std::string str = move2String(hist.move, hist.moveString);
-            write(str);
+            cmds.push_back(move2String(hist.move, hist.moveString));
         }
     }
     
-    write(timeControlString());
+    cmds.push_back(timeControlString());
+    write(cmds);
     
     if (feature_ping) {
-        // fake ping to avoid other cmd be run
-        expectingPongCnt++;
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        sendPing();
+        // the engine answers the ping after processing all above commands,
+        // the go command waits for that pong
+        sendFence();
     } else {
         setState(PlayerState::playing);
     }
@@ -188,7 +183,11 @@ bool WbEngine::go_straight()
     Engine::go();
     computingState = EngineComputingState::thinking;
     
-    return write(timeLeftString()) && write("go");
+    if (!write(std::vector<std::string>{ timeLeftString(), "go" })) {
+        return false;
+    }
+    goWritten();
+    return true;
 }
 
 std::string WbEngine::timeLeftString() const
@@ -262,10 +261,16 @@ std::string WbEngine::timeControlString() const
 bool WbEngine::sendPing()
 {
     assert(feature_ping);
-    expectingPongCnt++;
     return write("ping " + std::to_string(++pingCnt));
 }
 
+bool WbEngine::sendFence()
+{
+    // set before writing, the pong may come back before returning
+    fencePing = pingCnt + 1;
+    return sendPing();
+}
+
 bool WbEngine::sendPong(const std::string& str)
 {
     return write("pong " + str);
@@ -276,14 +281,11 @@ void WbEngine::tickWork()
     EngineProfile::tickWork();
 
     if (getState() == PlayerState::starting) {
-        if (tick_delay_2_ready > 0) {
-            tick_delay_2_ready--;
-            if (tick_delay_2_ready == 0) {
-                write("force");
-                if (feature_ping) {
-                    sendPing();
-                }
-                setState(PlayerState::ready);
+        i64 deadline = readyDeadline;
+        if (deadline > 0) {
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() >= deadline) {
+                readyDeadline = 0;
+                becomeReady();
             }
         } else if (tick_state > 10 * 2 && correctCmdCnt < 2) {
             // crashed
@@ -320,42 +322,45 @@ bool WbEngine::isFeatureOn(const std::string& featureName, bool defaultValue)
     return p == featureMap.end() ? defaultValue : p->second == "1";
 }
 
-bool WbEngine::sendMemoryAndCoreOptions()
+std::string WbEngine::memoryAndCoreOptionString()
 {
     // cores N, memory N
     std::string str;
     
-    if (isFeatureOn("memory")) {
-        Option option = ConfigMng::instance->getOverrideOption("memory");
+    // overridden, set by the config or declared by the engine (as features smp, memory)
+    auto findOption = [&](const std::string& name) {
+        Option option = ConfigMng::instance->getOverrideOption(name);
         if (!option.isValid()) {
-            for(auto && o : config.optionList) {
-                if (o.name == "memory") {
-                    option = o;
-                    break;
+            auto o = config->getOption(name);
+            if (o) {
+                option = *o;
+            } else {
+                for(auto && p : handshake.optionList) {
+                    if (p.name == name) {
+                        option = p;
+                        break;
+                    }
                 }
             }
         }
+        return option;
+    };
+    
+    if (isFeatureOn("memory")) {
+        auto option = findOption("memory");
         if (option.isValid()) {
             str += option.name + " " + option.getValueAsString();
         }
     }
     if (isFeatureOn("smp")) {
-        Option option = ConfigMng::instance->getOverrideOption("cores");
-        if (!option.isValid()) {
-            for(auto && o : config.optionList) {
-                if (o.name == "cores") {
-                    option = o;
-                    break;
-                }
-            }
-        }
+        auto option = findOption("cores");
         if (option.isValid()) {
             if (!str.empty()) str += "\n";
             str += option.name + " " + option.getValueAsString();
         }
     }
 
-    return !str.empty() && write(str);
+    return str;
 }
 
 bool WbEngine::parseFeature(const std::string& name, const std::string& content, bool quote)
@@ -369,7 +374,7 @@ bool WbEngine::parseFeature(const std::string& name, const std::string& content,
         if (vec.size() < 2) return true;
         auto optionName = vec.front();
         
-        for(auto && o : config.optionList) {
+        for(auto && o : config->optionList) {
             if (o.name != optionName) {
                 continue;
             }
@@ -386,6 +391,30 @@ bool WbEngine::parseFeature(const std::string& name, const std::string& content,
         return true;
     }
     
+    if (name == "done") {
+        if (content == "0") {
+            extendReadyDeadline(60 * 60 * 1000); // 1h
+            feature_done_finished = false;
+            handshake.doneDelayed = true;
+        } else {
+            feature_done_finished = true;
+            readyDeadline = 0;
+            if (getState() == PlayerState::starting) {
+                setState(PlayerState::ready);
+                handshakeCompleted();
+            }
+        }
+        return true;
+    }
+    
+    applyFeature(name, content);
+    write("accepted " + name);
+    return true;
+}
+
+// state of a feature, it could be from the engine or a cached handshake
+void WbEngine::applyFeature(const std::string& name, const std::string& content)
+{
     if (name == "san") {
         feature_san = content == "1";
     } else if (name == "usermove") {
@@ -393,23 +422,14 @@ bool WbEngine::parseFeature(const std::string& name, const std::string& content,
     } else if (name == "ping") {
         feature_ping = content == "1";
     } else if (name == "variants") {
-        config.variantSet.clear();
+        handshake.variantSet.clear();
         auto varList = splitString(content, ',');
         for(auto && s : varList) {
             trim(s);
             if (!s.empty()) {
-                config.variantSet.insert(s);
+                handshake.variantSet.insert(s);
             }
         }
-    } else if (name == "done") {
-        if (content == "0") {
-            tick_delay_2_ready = 60 * 60 * 2; // 1h
-            feature_done_finished = false;
-        } else {
-            setState(PlayerState::ready);
-            feature_done_finished = true;
-        }
-        return true;
     } else if (name == "smp" || name == "memory") { // changed into option
         if (content == "1") {
             int dInt = name == "smp" ? 1 : 16, minInt = 1, maxInt = 256;
@@ -417,24 +437,57 @@ bool WbEngine::parseFeature(const std::string& name, const std::string& content,
             option.name = name == "smp" ? "cores" : "memory";
             option.type = OptionType::spin;
             option.setDefaultValue(dInt, minInt, maxInt);
-            config.updateOption(option);
+            addEngineOption(option);
         }
     } else if (name == "myname") {
-        config.idName = content;
+        handshake.idName = content;
     }
     
-    write("accepted " + name);
-    
     featureMap[name] = content;
-    
-    return true;
+}
+
+void WbEngine::handshakeCompleted()
+{
+    handshake.featureMap = featureMap;
+    saveHandshake();
+}
+
+// With a cached handshake, features are known before the engine sends them
+bool WbEngine::sendProtocol()
+{
+    if (findHandshake()) {
+        for(auto && p : handshake.featureMap) {
+            applyFeature(p.first, p.second);
+        }
+    }
+    return Engine::sendProtocol();
+}
+
+// Engines may not send feature done=1 (e.g. protocol version 1), they are ready after
+// a quiet period since their last lines
+void WbEngine::extendReadyDeadline(i64 ms)
+{
+    auto t = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + ms;
+    if (t > readyDeadline) {
+        readyDeadline = t;
+    }
+}
+
+void WbEngine::becomeReady()
+{
+    write("force");
+    if (feature_ping) {
+        sendPing();
+    }
+    setState(PlayerState::ready);
+    handshakeCompleted();
 }
 
 void WbEngine::parseFeatures(const std::string& line)
 {
     // "feature " length = 8
     std::string featureName;
-    for(size_t i = 8, k = -1, quote = 0; i < line.size(); i++) {
+    for(int i = 8, k = -1, quote = 0; i < int(line.size()); i++) {
         auto ch = line[i];
         if (ch == '=') {
             if (k < 0 || i <= k) break; // somethings wrong
@@ -490,10 +543,8 @@ std::string WbEngine::move2String(const Move& move, const std::string& sanMoveSt
 
 bool WbEngine::oppositeMadeMove(const Move& move, const std::string& sanMoveString)
 {
-    write("force"); // we don't want this engine starts calculating after this move
-    
-    std::string str = move2String(move, sanMoveString);
-    return write(str);
+    // force: we don't want this engine starts calculating after this move
+    return write(std::vector<std::string>{ "force", move2String(move, sanMoveString) });
 }
 
 bool WbEngine::engineMove(const std::string& moveString, bool mustSend)
@@ -515,7 +566,7 @@ bool WbEngine::engineMove(const std::string& moveString, bool mustSend)
     }
     
     if (mustSend || move.isValid()) {
-        auto period = timeCtrl->moveTimeConsumed(); // moveTimeConsumed();
+        auto period = moveTimeConsumed(timeCtrl);
         
         auto oldComputingState = computingState;
         computingState = EngineComputingState::idle;
@@ -556,7 +607,9 @@ void WbEngine::parseLine(int cmdInt, const std::string& cmdString, const std::st
         return;
     }
     
-    if (tick_delay_2_ready < 0) tick_delay_2_ready = 3;
+    if (getState() == PlayerState::starting && feature_done_finished) {
+        extendReadyDeadline(1500);
+    }
     
     auto cmd = static_cast<WbEngineCmd>(cmdInt);
     switch (cmd) {
@@ -573,8 +626,12 @@ void WbEngine::parseLine(int cmdInt, const std::string& cmdString, const std::st
 
         case WbEngineCmd::feature:
         {
-            tick_delay_2_ready = std::max(3, tick_delay_2_ready); // extent init time a bit
             parseFeatures(line);
+            
+            // the engine is alive and its features are known, don't wait for the rest
+            if (handshakeHit && !handshake.doneDelayed && getState() == PlayerState::starting) {
+                becomeReady();
+            }
             break;
         }
 
@@ -587,10 +644,19 @@ void WbEngine::parseLine(int cmdInt, const std::string& cmdString, const std::st
 
         case WbEngineCmd::pong:
         {
-            expectingPongCnt = 0;
             pongCnt++;
+            
+            // pongs of older pings don't open the fence
+            auto vec = splitString(line, ' ');
+            auto n = vec.size() >= 2 ? std::atoi(vec.at(1).c_str()) : pingCnt;
+            if (n > lastPong) {
+                lastPong = n;
+            }
+            if (isFenced()) {
+                break;
+            }
 
-            if (getState() == PlayerState::ready) {
+            if (fencePing.exchange(0) > 0 && getState() == PlayerState::ready) {
                 setState(PlayerState::playing);
             }
             doSyncTask();
@@ -44,7 +44,7 @@ namespace banksia {
         
     public:
         WbEngine() : EngineProfile() {}
-        WbEngine(const Config& config) : EngineProfile(config) {}
+        WbEngine(const ConfigPtr& config) : EngineProfile(config) {}
         virtual ~WbEngine() {}
 
         virtual const char* className() const override { return "WbEngine"; }
@@ -76,10 +76,20 @@ namespace banksia {
         
         void parseFeatures(const std::string& line);
         bool parseFeature(const std::string& featureName, const std::string& content, bool quote);
+        void applyFeature(const std::string& featureName, const std::string& content);
+        
+        bool sendProtocol() override;
+        void becomeReady();
+        void extendReadyDeadline(i64 ms);
+        
+        // a ping the engine must answer before queued tasks (new game, go) run
+        bool sendFence();
+        bool isFenced() const { return fencePing > lastPong; }
+        void handshakeCompleted();
         
         bool engineMove(const std::string& moveString, bool mustSend);
         bool isFeatureOn(const std::string& featureName, bool defaultValue = false);
-        bool sendMemoryAndCoreOptions();
+        std::string memoryAndCoreOptionString();
         
         bool isIdleCrash() const override;
         void tickPing() override;
@@ -92,9 +102,13 @@ namespace banksia {
         
         std::map<std::string, std::string> featureMap;
         
-        int pingCnt = 0, expectingPongCnt = 0, pongCnt = 0;
+        int pingCnt = 0, pongCnt = 0;
+        std::atomic<int> fencePing { 0 }, lastPong { 0 };
         static const std::unordered_map<std::string, int> wbEngineCmd;
-        int tick_delay_2_ready = -1;
+        
+        // while starting, the engine becomes ready at this time (ms of steady clock, 0: not set)
+        // if it doesn't send feature done=1 before
+        std::atomic<i64> readyDeadline { 0 };
         
         bool feature_san = false, feature_usermove = false, feature_ping = false;
         bool feature_done_finished = true;
@@ -0,0 +1,194 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "workerpool.h"
+
+using namespace banksia;
+
+// the pool and the index of the current thread if it is a worker
+static thread_local WorkerPool* currentPool = nullptr;
+static thread_local int currentWorkerIdx = -1;
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(int threadCnt)
+{
+    if (!threadList.empty()) {
+        return;
+    }
+    
+    stopping = false;
+    parkedCnt = 0;
+    threadCnt = std::max(1, threadCnt);
+    for(int i = 0; i < threadCnt; i++) {
+        queueList.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue));
+    }
+    for(int i = 0; i < threadCnt; i++) {
+        threadList.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+    }
+}
+
+void WorkerPool::stop()
+{
+    if (stopping.exchange(true)) {
+        return;
+    }
+    
+    for(auto && queue : queueList) {
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        queue->parked = false;
+        queue->cv.notify_one();
+    }
+    
+    for(auto && t : threadList) {
+        if (t.get_id() == std::this_thread::get_id()) {
+            t.detach();
+        } else if (t.joinable()) {
+            t.join();
+        }
+    }
+    threadList.clear();
+    
+    // drain: tasks waiting in the queues are run here, thus they are never lost
+    // (games rely on their tasks to clear their scheduled flags)
+    for(auto && queue : queueList) {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> queueLock(queue->mutex);
+            tasks.swap(queue->tasks);
+        }
+        for(auto && task : tasks) {
+            task();
+        }
+    }
+    
+    queueList.clear();
+}
+
+bool WorkerPool::submit(std::function<void()> task)
+{
+    if (stopping || queueList.empty()) {
+        return false;
+    }
+    
+    auto n = static_cast<int>(queueList.size());
+    auto idx = currentPool == this ? currentWorkerIdx : static_cast<int>(nextQueue++ % n);
+    {
+        auto& queue = queueList[idx];
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        queue->tasks.push_back(std::move(task));
+    }
+    
+    // the task is in the queue before the counter is read, a worker going to sleep
+    // counts itself before its last look at the queues. Either one sees the other
+    if (parkedCnt > 0) {
+        wakeUp(idx);
+    }
+    return true;
+}
+
+// Wake the owner of the queue if it is sleeping, otherwise any sleeping one to steal the task
+void WorkerPool::wakeUp(int idx)
+{
+    auto n = static_cast<int>(queueList.size());
+    for(int i = 0; i < n; i++) {
+        auto& queue = queueList[(idx + i) % n];
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        if (queue->parked) {
+            queue->parked = false;
+            parkedCnt--;
+            queue->cv.notify_one();
+            return;
+        }
+    }
+}
+
+bool WorkerPool::popTask(int idx, std::function<void()>& task)
+{
+    auto n = static_cast<int>(queueList.size());
+    for(int i = 0; i < n; i++) {
+        auto& queue = queueList[(idx + i) % n];
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        if (queue->tasks.empty()) {
+            continue;
+        }
+        
+        // own queue from the front, the others from the back
+        if (i == 0) {
+            task = std::move(queue->tasks.front());
+            queue->tasks.pop_front();
+        } else {
+            task = std::move(queue->tasks.back());
+            queue->tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::workerLoop(int idx)
+{
+    currentPool = this;
+    currentWorkerIdx = idx;
+    auto& queue = *queueList[idx];
+    
+    while (!stopping) {
+        std::function<void()> task;
+        if (popTask(idx, task)) {
+            task();
+            continue;
+        }
+        
+        // going to sleep: count itself first, then look at the queues once more
+        {
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.parked = true;
+        }
+        parkedCnt++;
+        
+        if (popTask(idx, task)) {
+            {
+                std::lock_guard<std::mutex> queueLock(queue.mutex);
+                if (queue.parked) { // not woken up (and uncounted) by a submitter
+                    queue.parked = false;
+                    parkedCnt--;
+                }
+            }
+            task();
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> queueLock(queue.mutex);
+        queue.cv.wait(queueLock, [&] { return !queue.parked || stopping; });
+        if (queue.parked) {
+            queue.parked = false;
+            parkedCnt--;
+        }
+    }
+}
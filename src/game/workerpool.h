@@ -0,0 +1,85 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+
+#ifndef workerpool_h
+#define workerpool_h
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace banksia {
+    
+    // A fixed set of threads, each one has its own queue. Tasks submitted by a worker go to
+    // its own queue, others are given to the queues in turn. An idle thread takes tasks from
+    // the front of its queue or steals from the back of the others, thus a slow task doesn't
+    // hold the ones behind it. Only the locks of the queues are taken on the way, a thread
+    // without work sleeps on the condition variable of its queue until a task comes
+    class WorkerPool
+    {
+    public:
+        WorkerPool() {}
+        ~WorkerPool();
+        
+        void start(int threadCnt);
+        // queued tasks which haven't started yet are run by the caller before returning
+        void stop();
+        
+        bool submit(std::function<void()> task);
+        
+        int size() const {
+            return static_cast<int>(threadList.size());
+        }
+        
+    private:
+        void workerLoop(int idx);
+        bool popTask(int idx, std::function<void()>& task);
+        void wakeUp(int idx);
+        
+    private:
+        class WorkerQueue {
+        public:
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::deque<std::function<void()>> tasks;
+            bool parked = false; // the worker is sleeping or about to sleep, guarded by mutex
+        };
+        
+        std::vector<std::unique_ptr<WorkerQueue>> queueList;
+        std::vector<std::thread> threadList;
+        
+        std::atomic<bool> stopping { false };
+        std::atomic<int> parkedCnt { 0 };
+        std::atomic<unsigned> nextQueue { 0 };
+    };
+    
+} // namespace banksia
+
+#endif /* workerpool_h */
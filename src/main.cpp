@@ -63,7 +63,7 @@ int main(int argc, const char * argv[])
         std::string str = arg;
         auto ok = true;
         
-        if (arg == "-t" || arg == "-jsonpath" || arg == "-d" || arg == "-c" || arg == "-v") {
+        if (arg == "-t" || arg == "-jsonpath" || arg == "-d" || arg == "-c" || arg == "-v" || arg == "-archive" || arg == "-pgn") {
             if (i + 1 < argc) {
                 i++;
                 str = argv[i];
@@ -98,6 +98,12 @@ int main(int argc, const char * argv[])
 #endif
     }
     
+    if (argmap.find("-archive") != argmap.end()) {
+        auto archivePath = argmap["-archive"];
+        auto pgnPath = argmap.find("-pgn") != argmap.end() ? argmap["-pgn"] : archivePath + ".pgn";
+        return banksia::GameArchive::convertToPgn(archivePath, pgnPath) ? 0 : -1;
+    }
+    
     banksia::JsonMaker maker;
     banksia::TourMng tourMng;
     
@@ -201,6 +207,10 @@ void show_usage(std::string name)
     << "               banksia -u -d c:\\myengines, will create engines.json and tour.json files at the folder where\n"
     << "               banksia.exe is located. banksia will search the engines located in c:\\myengines in this case.\n"
     << "  -v on|off    turn on/off verbose (default on)\n"
+    << "  -archive PATH\n"
+    << "               Convert a game archive (binary file) into a PGN file. Example:\n"
+    << "               banksia -archive c:\\games.bka -pgn c:\\games.pgn\n"
+    << "  -pgn PATH    The PGN file for -archive, default is the archive path with \".pgn\" added\n"
     
 #ifdef _WIN32
     << "  -profile     profile engines (cpu, mem, threads)\n"
@@ -0,0 +1,286 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <map>
+
+#include "test.h"
+#include "../game/gamearchive.h"
+
+namespace banksia {
+
+static const std::string testArchivePath = "banksia-test.bka";
+static const std::string testPgnPath = "banksia-test.pgn";
+
+static void removeTestFiles()
+{
+    std::remove(testArchivePath.c_str());
+    std::remove((testArchivePath + ".idx").c_str());
+    std::remove(testPgnPath.c_str());
+}
+
+static std::string readWholeFile(const std::string& path)
+{
+    std::ifstream inFile(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+}
+
+static std::string randomString(std::mt19937& rng, int len)
+{
+    static const char chars[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::string str;
+    for(int i = 0; i < len; i++) {
+        str += chars[rng() % (sizeof(chars) - 1)];
+    }
+    return str;
+}
+
+// A game of random legal moves, its board keeps the moves for comparing later
+class TestArchiveGame {
+public:
+    ArchiveGame game;
+    ChessBoard board;
+};
+
+static TestArchiveGame makeGame(std::mt19937& rng, int gameIdx, int plyCnt, const std::string& fen, const std::string& white, const std::string& black)
+{
+    TestArchiveGame g;
+    g.board.newGame(fen);
+    for(int i = 0; i < plyCnt; i++) {
+        std::vector<MoveFull> moveList;
+        g.board.genLegalOnly(moveList, g.board.side);
+        if (moveList.empty()) {
+            break;
+        }
+        auto& move = moveList[rng() % moveList.size()];
+        g.board.checkMake(move.from, move.dest, move.promotion);
+        auto& hist = g.board.histList.back();
+        hist.score = static_cast<int>(rng() % 600) - 300;
+        hist.depth = static_cast<int>(rng() % 30);
+        hist.elapsed = (rng() % 5000) / 1000.0;
+    }
+    g.board.result = Result(static_cast<ResultType>(1 + rng() % 3), ReasonType::adjudication);
+    
+    g.game.setBoard(g.board);
+    g.game.gameIdx = gameIdx;
+    g.game.round = 1 + gameIdx / 4;
+    g.game.time = 1500000000 + gameIdx;
+    g.game.names[W] = white;
+    g.game.names[B] = black;
+    return g;
+}
+
+// The same knight moves back and forth, records of such games are long matches of each other and of themselves
+static TestArchiveGame makeRepeatedGame(int gameIdx, int plyCnt)
+{
+    static const char* sans[] = { "Nf3", "Nf6", "Ng1", "Ng8" };
+    TestArchiveGame g;
+    g.board.newGame();
+    for(int i = 0; i < plyCnt; i++) {
+        auto move = g.board.fromSanString(sans[i % 4]);
+        g.board.checkMake(move.from, move.dest, move.promotion);
+    }
+    g.board.result = Result(ResultType::draw, ReasonType::repetition);
+    
+    g.game.setBoard(g.board);
+    g.game.gameIdx = gameIdx;
+    g.game.round = 1;
+    g.game.names[W] = "engine A";
+    g.game.names[B] = "engine B";
+    return g;
+}
+
+class PgnGame {
+public:
+    std::map<std::string, std::string> tags;
+    std::string moveText;
+};
+
+static std::vector<PgnGame> readPgnGames(const std::string& path)
+{
+    std::vector<PgnGame> games;
+    std::ifstream inFile(path);
+    std::string line;
+    auto inMoveText = false;
+    while (std::getline(inFile, line)) {
+        if (!line.empty() && line.at(0) == '[') {
+            if (inMoveText || games.empty()) {
+                games.push_back(PgnGame());
+                inMoveText = false;
+            }
+            auto p = line.find(" \"");
+            if (p != std::string::npos && line.size() > p + 3) {
+                games.back().tags[line.substr(1, p - 1)] = line.substr(p + 2, line.size() - p - 4);
+            }
+        } else if (!line.empty() && !games.empty()) {
+            inMoveText = true;
+            games.back().moveText += line + " ";
+        }
+    }
+    
+    // comments may have spaces inside
+    for(auto && g : games) {
+        std::string s;
+        auto depth = 0;
+        for(auto ch : g.moveText) {
+            if (ch == '{') depth++;
+            else if (ch == '}') depth--;
+            else if (depth == 0) s += ch;
+        }
+        g.moveText = s;
+    }
+    return games;
+}
+
+static void checkPgnGame(const PgnGame& pgnGame, const TestArchiveGame& g)
+{
+    auto tag = [&](const std::string& name) {
+        auto it = pgnGame.tags.find(name);
+        return it == pgnGame.tags.end() ? std::string() : it->second;
+    };
+    
+    CHECK(tag("White") == g.game.names[W]);
+    CHECK(tag("Black") == g.game.names[B]);
+    CHECK(tag("Result") == g.board.result.toShortString());
+    CHECK(tag("Board") == std::to_string(g.game.gameIdx + 1));
+    CHECK(tag("Round") == std::to_string(g.game.round));
+    CHECK(tag("Termination") == g.board.result.reasonString());
+    CHECK(tag("FEN") == g.game.startFen);
+    CHECK(tag("TimeControl") == "40/60");
+    CHECK(tag("Event") == "archive test");
+    
+    ChessBoard board;
+    board.newGame(tag("FEN"));
+    CHECK(board.fromSanMoveList(pgnGame.moveText));
+    CHECK(board.histList.size() == g.board.histList.size());
+    if (board.histList.size() != g.board.histList.size()) {
+        return;
+    }
+    for(size_t i = 0; i < board.histList.size(); i++) {
+        auto& m0 = board.histList[i].move;
+        auto& m1 = g.board.histList[i].move;
+        CHECK(m0.from == m1.from && m0.dest == m1.dest && m0.promotion == m1.promotion);
+    }
+}
+
+static bool writeArchive(const std::vector<TestArchiveGame>& games)
+{
+    GameArchive archive;
+    if (!archive.open(testArchivePath, "archive test", "here", "40/60")) {
+        return false;
+    }
+    for(auto && g : games) {
+        archive.add(g.game);
+    }
+    archive.close();
+    return true;
+}
+
+static void checkArchive(const std::vector<TestArchiveGame>& games)
+{
+    CHECK(GameArchive::convertToPgn(testArchivePath, testPgnPath));
+    auto pgnGames = readPgnGames(testPgnPath);
+    CHECK(pgnGames.size() == games.size());
+    for(size_t i = 0; i < pgnGames.size() && i < games.size(); i++) {
+        checkPgnGame(pgnGames[i], games[i]);
+    }
+}
+
+static u32 readU32(const std::string& data, size_t offset)
+{
+    u32 v = 0;
+    for(int i = 0; i < 4; i++) {
+        v |= static_cast<u32>(static_cast<u8>(data.at(offset + i))) << (i * 8);
+    }
+    return v;
+}
+
+void testGameArchive()
+{
+    std::mt19937 rng(4601);
+    const size_t signatureSize = 8, headerSize = 12;
+    
+    // empty: no block is written, nothing is converted
+    removeTestFiles();
+    std::vector<TestArchiveGame> games;
+    CHECK(writeArchive(games));
+    CHECK(readWholeFile(testArchivePath).size() == signatureSize);
+    checkArchive(games);
+    
+    // a game without moves and ones from a position of FEN
+    removeTestFiles();
+    games.push_back(makeGame(rng, 0, 0, "", "white", "black"));
+    games.push_back(makeGame(rng, 1, 60, "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "white", "black"));
+    games.push_back(makeGame(rng, 2, 200, "", "black", "white"));
+    CHECK(writeArchive(games));
+    checkArchive(games);
+    
+    // incompressible: long random names, the block is stored as it is
+    removeTestFiles();
+    games.clear();
+    games.push_back(makeGame(rng, 0, 10, "", randomString(rng, 3000), randomString(rng, 3000)));
+    CHECK(writeArchive(games));
+    auto data = readWholeFile(testArchivePath);
+    CHECK(data.size() > signatureSize + headerSize && readU32(data, signatureSize) == readU32(data, signatureSize + 4));
+    checkArchive(games);
+    
+    // long matches (longer than 15 + 255 bytes) and overlapped ones, a few blocks
+    removeTestFiles();
+    games.clear();
+    for(int i = 0; i < 300; i++) {
+        games.push_back(makeRepeatedGame(i, 400));
+    }
+    CHECK(writeArchive(games));
+    data = readWholeFile(testArchivePath);
+    CHECK(data.size() > signatureSize + headerSize && readU32(data, signatureSize + 4) * 10 < readU32(data, signatureSize));
+    checkArchive(games);
+    
+    // a partial block and a partial index entry left by a crash are cut off when opened again
+    removeTestFiles();
+    games.clear();
+    for(int i = 0; i < 3; i++) {
+        games.push_back(makeGame(rng, i, 80, "", "white", "black"));
+    }
+    CHECK(writeArchive(games));
+    auto archiveSize = readWholeFile(testArchivePath).size();
+    {
+        std::ofstream outFile(testArchivePath, std::ios::binary | std::ios::app);
+        outFile << std::string("\x40\x00\x00\x00\x40\x00\x00\x00\x01\x00\x00\x00garbage", 19);
+        std::ofstream indexFile(testArchivePath + ".idx", std::ios::binary | std::ios::app);
+        indexFile << "part";
+    }
+    std::vector<TestArchiveGame> moreGames;
+    moreGames.push_back(makeGame(rng, 3, 80, "", "white", "black"));
+    CHECK(writeArchive(moreGames));
+    CHECK(readWholeFile(testArchivePath).size() > archiveSize);
+    CHECK(readWholeFile(testArchivePath + ".idx").size() == 4 * 16);
+    games.push_back(moreGames.front());
+    checkArchive(games);
+    
+    removeTestFiles();
+}
+
+} // namespace banksia
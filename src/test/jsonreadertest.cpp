@@ -0,0 +1,246 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstdio>
+#include <fstream>
+
+#include "test.h"
+#include "../game/tourmng.h"
+#include "../game/jsonreader.h"
+
+namespace banksia {
+
+static const std::string testJsonPath = "banksia-test.json";
+
+class TestTourMng : public TourMng {
+public:
+    using TourMng::saveMatchRecords;
+    using TourMng::removeMatchRecordFile;
+    using TourMng::matchRecordList;
+    using TourMng::playerRegistry;
+    using TourMng::type;
+    using TourMng::timeController;
+};
+
+#ifdef _WIN32
+static const std::string testMatchPath = "playing.json";
+#else
+static const std::string testMatchPath = "./playing.json";
+#endif
+
+static std::string readWholeFile(const std::string& path)
+{
+    std::ifstream inFile(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+}
+
+static void writeWholeFile(const std::string& path, const std::string& data)
+{
+    std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+    outFile << data;
+}
+
+// Records read by MatchRecord::load from the stream, as loadMatchRecords does
+static bool loadByReader(const std::string& path, std::vector<MatchRecord>& recordList, PlayerRegistry& registry)
+{
+    JsonReader reader;
+    if (!reader.open(path) || !reader.beginObject()) {
+        return false;
+    }
+    for(std::string key; reader.nextMember(key);) {
+        if (key == "recordList" && reader.peek() == JsonReader::ValueType::array) {
+            reader.beginArray();
+            while (reader.nextElement()) {
+                MatchRecord record;
+                if (record.load(reader, registry)) {
+                    recordList.push_back(record);
+                }
+            }
+        } else {
+            reader.skipValue();
+        }
+    }
+    return !reader.hasError();
+}
+
+// Records from a whole document parsed by jsoncpp, the way they were loaded before the stream reader
+static bool loadByJsoncpp(const std::string& path, std::vector<MatchRecord>& recordList, PlayerRegistry& registry)
+{
+    Json::Value d;
+    if (!JsonSavable::loadFromJsonFile(path, d, false)) {
+        return false;
+    }
+    
+    auto& a = d["recordList"];
+    for(Json::ArrayIndex i = 0; i < a.size(); i++) {
+        auto& obj = a[i];
+        MatchRecord record;
+        for(int sd = 0; sd < 2; sd++) {
+            auto name = obj["players"][sd].asString();
+            record.playerIds[sd] = name.empty() ? -1 : registry.add(name);
+        }
+        record.startFen = obj.get("startFen", "").asString();
+        auto& moves = obj["startMoves"];
+        for(Json::ArrayIndex j = 0; j < moves.size(); j++) {
+            auto k = moves[j].asInt();
+            record.startMoves.push_back(Move(k & 0xff, k >> 8 & 0xff, static_cast<PieceType>(k >> 16 & 0xff)));
+        }
+        record.result.result = string2ResultType(obj["result"].asString());
+        record.result.reason = string2ReasonType(obj["reason"].asString());
+        record.state = record.result.result == ResultType::noresult ? MatchState::none : MatchState::completed;
+        record.gameIdx = obj["gameIdx"].asInt();
+        record.round = obj["round"].asInt();
+        record.pairId = obj["pairId"].asInt();
+        recordList.push_back(record);
+    }
+    return true;
+}
+
+static void checkSameRecords(const std::string& path)
+{
+    std::vector<MatchRecord> list0, list1;
+    PlayerRegistry registry0, registry1;
+    CHECK(loadByReader(path, list0, registry0));
+    CHECK(loadByJsoncpp(path, list1, registry1));
+    CHECK(!list0.empty() && list0.size() == list1.size());
+    
+    for(size_t i = 0; i < list0.size() && i < list1.size(); i++) {
+        auto& r0 = list0[i];
+        auto& r1 = list1[i];
+        for(int sd = 0; sd < 2; sd++) {
+            CHECK(registry0.getName(r0.playerIds[sd]) == registry1.getName(r1.playerIds[sd]));
+            CHECK((r0.playerIds[sd] < 0) == (r1.playerIds[sd] < 0));
+        }
+        CHECK(r0.startFen == r1.startFen);
+        CHECK(r0.startMoves.size() == r1.startMoves.size());
+        for(size_t j = 0; j < r0.startMoves.size() && j < r1.startMoves.size(); j++) {
+            auto& m0 = r0.startMoves[j];
+            auto& m1 = r1.startMoves[j];
+            CHECK(m0.from == m1.from && m0.dest == m1.dest && m0.promotion == m1.promotion);
+        }
+        CHECK(r0.result.result == r1.result.result && r0.result.reason == r1.result.reason);
+        CHECK(r0.state == r1.state);
+        CHECK(r0.gameIdx == r1.gameIdx && r0.round == r1.round && r0.pairId == r1.pairId);
+    }
+}
+
+static void fillRecords(TestTourMng& tourMng, int recordCnt)
+{
+    static const char* names[] = {
+        "plain", "with \"quotes\"", "back\\slash \\\\ and /slash/", "tab\tnew\nline\rreturn",
+        "control \x01\x1f chars", "caf\xc3\xa9 \xe2\x99\x9e", "emoji \xf0\x9f\x98\x80", "",
+    };
+    const int nameCnt = sizeof(names) / sizeof(names[0]);
+    
+    tourMng.matchRecordList.clear();
+    for(int i = 0; i < recordCnt; i++) {
+        auto name0 = std::string(names[i % nameCnt]), name1 = std::string(names[(i + 3) % nameCnt]) + std::to_string(i % 50);
+        MatchRecord record(name0.empty() ? -1 : tourMng.playerRegistry.add(name0), tourMng.playerRegistry.add(name1), i & 1);
+        if (i % 3 == 0) {
+            record.startFen = "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1";
+        }
+        for(int j = 0; j < i % 7; j++) {
+            record.startMoves.push_back(Move(j * 9 % 64, (j * 13 + 8) % 64, static_cast<PieceType>(j % 6)));
+        }
+        record.result = Result(static_cast<ResultType>(i % 4), i % 4 ? ReasonType::mate : ReasonType::noreason);
+        record.state = i % 4 ? MatchState::completed : MatchState::none;
+        record.gameIdx = i;
+        record.round = 1 + i / 10;
+        record.pairId = i / 2;
+        tourMng.matchRecordList.push_back(record);
+    }
+}
+
+// A prefix of a document must fail to load, not crash or loop
+static void checkTruncated(const std::string& data, size_t len)
+{
+    writeWholeFile(testJsonPath, data.substr(0, len));
+    std::vector<MatchRecord> list;
+    PlayerRegistry registry;
+    CHECK(!loadByReader(testJsonPath, list, registry));
+}
+
+void testJsonReader()
+{
+    TestTourMng tourMng;
+    tourMng.type = TourType::swiss;
+    tourMng.timeController.setup(TimeControlMode::standard, 40, 60);
+    
+    // a few records, every prefix of the file is truncated
+    fillRecords(tourMng, 24);
+    tourMng.saveMatchRecords();
+    checkSameRecords(testMatchPath);
+    
+    auto data = readWholeFile(testMatchPath);
+    auto lastBrace = data.rfind('}');
+    CHECK(lastBrace != std::string::npos);
+    for(size_t len = 0; len < lastBrace + 1 && lastBrace != std::string::npos; len++) {
+        checkTruncated(data, len);
+    }
+    
+    // larger than the buffer of the reader, strings and numbers go across its chunks
+    fillRecords(tourMng, 3000);
+    tourMng.saveMatchRecords();
+    checkSameRecords(testMatchPath);
+    data = readWholeFile(testMatchPath);
+    CHECK(data.size() > 3 * 64 * 1024);
+    for(size_t len = 64 * 1024 - 40; len < 64 * 1024 + 40; len++) {
+        checkTruncated(data, len);
+    }
+    
+    // members unknown to records with nested arrays and objects are skipped, escapes of all kinds
+    data = "{\n"
+        "  // comments are accepted as jsoncpp does\n"
+        "  \"type\" : \"roundrobin\",\n"
+        "  \"nested\" : [[1, [2, [3, []]]], {\"a\" : [{\"b\" : [true, false, null]}]}, -1.5e3],\n"
+        "  \"recordList\" : [\n"
+        "    {\"players\" : [\"\\u00e9\\ud83d\\ude00\\/\\\"\\\\\\b\\f\\n\\r\\t\", \"B\"], \"extra\" : [[[]], [{\"x\" : [1, 2]}]],\n"
+        "     \"startMoves\" : [1, 2, 65536], \"result\" : \"1-0\", \"reason\" : \"mate\", \"gameIdx\" : 0, \"round\" : 1, \"pairId\" : 0},\n"
+        "    /* a bye */\n"
+        "    {\"players\" : [\"\", \"B\"], \"result\" : \"*\", \"gameIdx\" : 1, \"round\" : 2, \"pairId\" : 1, \"more\" : {\"deep\" : [[[[0]]]]}}\n"
+        "  ],\n"
+        "  \"elapsed\" : 12\n"
+        "}\n";
+    writeWholeFile(testJsonPath, data);
+    checkSameRecords(testJsonPath);
+    
+    std::vector<MatchRecord> list;
+    PlayerRegistry registry;
+    CHECK(loadByReader(testJsonPath, list, registry));
+    CHECK(list.size() == 2 && registry.getName(list[0].playerIds[0]) == "\xc3\xa9\xf0\x9f\x98\x80/\"\\\b\f\n\r\t");
+    CHECK(list.size() == 2 && list[1].isBye() && list[1].state == MatchState::none);
+    
+    // the whole document read as a value equals the one parsed by jsoncpp
+    JsonReader reader;
+    Json::Value value0, value1;
+    CHECK(reader.open(testJsonPath) && reader.readValue(value0));
+    reader.close();
+    CHECK(JsonSavable::loadFromJsonFile(testJsonPath, value1, false));
+    CHECK(value0 == value1);
+    
+    tourMng.removeMatchRecordFile();
+    std::remove(testJsonPath.c_str());
+}
+
+} // namespace banksia
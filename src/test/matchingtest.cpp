@@ -0,0 +1,129 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <random>
+
+#include "test.h"
+#include "../game/matching.h"
+
+namespace banksia {
+
+// Best total weight of matchings of the vertices from idx up, by trying all of them
+static i64 bruteForceMatching(const std::vector<i64>& weights, int n, std::vector<bool>& used, int idx)
+{
+    while (idx < n && used[idx]) {
+        idx++;
+    }
+    if (idx >= n) {
+        return 0;
+    }
+    
+    used[idx] = true;
+    auto best = bruteForceMatching(weights, n, used, idx + 1); // idx stays unmatched
+    for(int j = idx + 1; j < n; j++) {
+        auto w = weights[idx * n + j];
+        if (used[j] || w <= 0) {
+            continue;
+        }
+        used[j] = true;
+        best = std::max(best, w + bruteForceMatching(weights, n, used, idx + 1));
+        used[j] = false;
+    }
+    used[idx] = false;
+    return best;
+}
+
+// Solve the graph and compare the total weight with the brute force one
+static void checkMatching(const std::vector<i64>& weights, int n)
+{
+    WeightedMatching matching(n);
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) {
+            matching.setWeight(i, j, weights[i * n + j]);
+        }
+    }
+    
+    auto mates = matching.solve();
+    CHECK(static_cast<int>(mates.size()) == n);
+    if (static_cast<int>(mates.size()) != n) {
+        return;
+    }
+    
+    i64 sum = 0;
+    for(int i = 0; i < n; i++) {
+        auto j = mates[i];
+        if (j < 0) {
+            continue;
+        }
+        CHECK(j < n && j != i && mates[j] == i);
+        if (j > i && j < n) {
+            CHECK(weights[i * n + j] > 0);
+            sum += weights[i * n + j];
+        }
+    }
+    
+    std::vector<bool> used(n, false);
+    CHECK(sum == bruteForceMatching(weights, n, used, 0));
+}
+
+void testWeightedMatching()
+{
+    std::mt19937 rng(20181);
+    
+    // random graphs with missing edges, odd and even vertex counts
+    for(int n = 1; n <= 9; n++) {
+        for(int k = 0; k < 60; k++) {
+            std::vector<i64> weights(n * n, 0);
+            for(int i = 0; i < n; i++) {
+                for(int j = i + 1; j < n; j++) {
+                    auto w = static_cast<i64>(rng() % 12) - 3; // some non-positive ones are not edges
+                    weights[i * n + j] = weights[j * n + i] = w;
+                }
+            }
+            checkMatching(weights, n);
+        }
+    }
+    
+    // graphs built like Swiss pairings: a large base makes perfect matchings better than any others,
+    // an odd number of players gets the bye vertex, to which only some players may be paired
+    for(int playerCnt = 2; playerCnt <= 9; playerCnt++) {
+        auto n = playerCnt + (playerCnt & 1);
+        for(int k = 0; k < 40; k++) {
+            i64 base = 1000000;
+            std::vector<i64> weights(n * n, 0);
+            for(int i = 0; i < n; i++) {
+                for(int j = i + 1; j < n; j++) {
+                    auto w = base - static_cast<i64>(rng() % 50000);
+                    if (j == playerCnt && rng() % 3 == 0) { // the one has had a bye already
+                        w = 0;
+                    }
+                    weights[i * n + j] = weights[j * n + i] = w;
+                }
+            }
+            checkMatching(weights, n);
+        }
+    }
+}
+
+} // namespace banksia
@@ -0,0 +1,53 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "test.h"
+#include "../game/tourmng.h"
+
+namespace banksia {
+
+void testSprtStats()
+{
+    // one win, one draw, one loss of different pairs
+    SprtStats stats;
+    stats.add(2, 0);
+    stats.add(1, 1);
+    stats.add(0, 2);
+    CHECK(stats.trino[0] == 1); // losses
+    CHECK(stats.trino[1] == 1); // draws
+    CHECK(stats.trino[2] == 1); // wins
+    for(int i = 0; i < 5; i++) {
+        CHECK(stats.penta[i] == 0);
+    }
+
+    // a win and a draw of the same pair
+    stats.clear();
+    stats.add(2, 7);
+    CHECK(stats.penta[3] == 0);
+    stats.add(1, 7);
+    CHECK(stats.penta[3] == 1);
+    CHECK(stats.trino[1] == 1 && stats.trino[2] == 1);
+}
+
+} // namespace banksia
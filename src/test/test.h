@@ -0,0 +1,52 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef test_h
+#define test_h
+
+#include <iostream>
+
+namespace banksia {
+    extern int testFailedCnt;
+}
+
+// Print the failed condition and keep running the other checks
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            banksia::testFailedCnt++; \
+            std::cerr << "Error: " << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+        } \
+    } while (0)
+
+namespace banksia {
+    void testSprtStats();
+    void testUciPositionFen();
+    void testWbFeatures();
+    void testWeightedMatching();
+    void testGameArchive();
+    void testJsonReader();
+}
+
+#endif /* test_h */
@@ -0,0 +1,70 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "test.h"
+#include "../game/uciengine.h"
+
+namespace banksia {
+
+// to see the position command of its board
+class TestUciEngine : public UciEngine
+{
+public:
+    TestUciEngine(const ConfigPtr& config) : UciEngine(config) {}
+    using Player::board;
+    using UciEngine::getPositionString;
+};
+
+static std::string positionOf(TestUciEngine& engine)
+{
+    return engine.getPositionString(Move::illegalMove);
+}
+
+void testUciPositionFen()
+{
+    Config config;
+    config.positionFenPly = 1;
+    TestUciEngine engine(std::make_shared<const Config>(config));
+    
+    ChessBoard board;
+    engine.board = &board;
+    
+    // counters of the starting FEN are carried on
+    board.newGame("4k3/8/8/8/8/8/4P3/4K2R b K - 10 40");
+    CHECK(board.fromSanMoveList("Kd7 Kf1"));
+    CHECK(positionOf(engine) == "position fen 8/3k4/8/8/8/8/4P3/5K1R b - - 12 41");
+    
+    // a pawn move resets the half-move counter
+    CHECK(board.fromSanMoveList("Kc7 e4"));
+    CHECK(positionOf(engine) == "position fen 8/2k5/8/8/4P3/8/8/5K1R b - e3 0 42");
+    
+    // the origin position counts from zero and one
+    ChessBoard originBoard;
+    originBoard.newGame();
+    engine.board = &originBoard;
+    CHECK(originBoard.fromSanMoveList("Nf3 Nf6 Ng1"));
+    CHECK(positionOf(engine) == "position fen rnbqkb1r/pppppppp/5n2/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 3 2");
+}
+
+} // namespace banksia
@@ -0,0 +1,59 @@
+/*
+ This file is part of Banksia.
+ 
+ Copyright (c) 2019 Nguyen Hong Pham
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "test.h"
+#include "../game/wbengine.h"
+
+namespace banksia {
+
+// to feed lines as if they came from the engine
+class TestWbEngine : public WbEngine
+{
+public:
+    TestWbEngine() : WbEngine(std::make_shared<const Config>(Config())) {}
+    using Engine::parseLine;
+};
+
+void testWbFeatures()
+{
+    TestWbEngine engine;
+    engine.setHandshakeCaching(false);
+    engine.setState(PlayerState::starting);
+    
+    engine.parseLine("feature ping=1 usermove=1 san=1 myname=\"Foo 1.0\" done=1");
+    
+    // done=1 makes it ready, the features are kept in its handshake
+    CHECK(engine.getState() == PlayerState::ready);
+    
+    auto& handshake = engine.getHandshake();
+    CHECK(handshake.idName == "Foo 1.0");
+    
+    auto& featureMap = handshake.featureMap;
+    CHECK(featureMap.find("ping") != featureMap.end() && featureMap.at("ping") == "1");
+    CHECK(featureMap.find("usermove") != featureMap.end() && featureMap.at("usermove") == "1");
+    CHECK(featureMap.find("san") != featureMap.end() && featureMap.at("san") == "1");
+    CHECK(featureMap.find("myname") != featureMap.end() && featureMap.at("myname") == "Foo 1.0");
+}
+
+} // namespace banksia